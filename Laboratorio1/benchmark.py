@@ -0,0 +1,263 @@
+# Pruebas de regresión y rendimiento del contador de permutaciones gráciles.
+#
+# Uso:
+#   python benchmark.py [--programa ./programa] [--grande] [--base archivo.json] [--guardar]
+#                       [--umbral fraccion] [--tiempo_min ms] [-- opciones para programa]
+#       Ejecuta el programa para n = 4..16 (hasta 17 con --grande), verifica cada resultado
+#       contra la sucesión conocida y mide tiempo de pared, nodos por segundo y memoria máxima.
+#       Con --guardar escribe las mediciones como nueva línea base; si no, las compara con la
+#       línea base guardada y falla si el rendimiento cae por debajo de 'umbral' veces el de la base.
+#       Lo que vaya después de "--" se pasa tal cual al programa (p. ej. -- --hilos 4 --simetria),
+#       y cada combinación de opciones tiene su propia entrada en el archivo de línea base.
+#   python benchmark.py --nucleos [--programa ./programa] [--grande] [--repeticiones r] [-- opciones]
+#       Mide cada n con el núcleo especializado (--nucleo fijo) y con el genérico (--nucleo generico),
+#       toma el menor tiempo de 'r' ejecuciones de cada uno y muestra la ganancia del especializado.
+#   python benchmark.py --reanudar [--programa ./programa] [--grande] [--hilos h] [-- opciones]
+#       Para cada n corta la búsqueda apenas empieza (tiempo 0) con --checkpoint y h hilos, la
+#       reanuda cortándola otras REANUDACIONES_CORTADAS veces, la termina y compara el conteo con la
+#       sucesión conocida: un subárbol que se pierde o se cuenta dos veces al volcar la frontera
+#       aparece como un conteo distinto. Con '-- --motor iterativo' prueba el checkpoint del iterador
+#       (gp_iter_save / gp_iter_load) en vez de la frontera de prefijos.
+#
+# Códigos de salida: 0 si todo está bien, 1 por uso incorrecto, 2 si algún conteo es incorrecto,
+# 3 si hubo una regresión de rendimiento.
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+# Número de permutaciones gráciles de 1..n, para n = 1, 2, 3, ...
+# (verificados con el modo --comprobar hasta n = 12; los demás, con el motor de bits)
+SUCESION = [1, 2, 4, 4, 8, 24, 32, 40, 120, 296, 648, 1328, 3200, 9912, 25592, 55920, 143192]
+
+N_MIN = 4
+N_MAX = 16
+N_MAX_GRANDE = len(SUCESION)
+
+# Tiempo máximo (en minutos) que se le da a cada ejecución; basta con que nunca se agote
+TIEMPO_LIMITE_MIN = '600'
+
+# Reanudaciones con tiempo 0 entre el primer corte y la ejecución que termina (--reanudar)
+REANUDACIONES_CORTADAS = 2
+
+
+# Ejecuta el programa para un n y devuelve la medición (o un mensaje de error).
+def medir(programa, n, opciones):
+    comando = [programa, str(n), TIEMPO_LIMITE_MIN] + opciones
+    inicio = time.monotonic()
+
+    # Memoria máxima del proceso: os.wait4 entrega su rusage (ru_maxrss está en KB en Linux y en
+    # bytes en macOS). El preexec_fn obliga a usar fork en vez de vfork, porque con vfork el hijo
+    # hereda como máximo la memoria del propio intérprete de Python. La salida estándar es corta,
+    # así que leer primero stderr no se bloquea.
+    rss_kb = None
+    if hasattr(os, 'wait4'):
+        proceso = subprocess.Popen(comando, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                   universal_newlines=True, preexec_fn=os.getpid)
+        errores = proceso.stderr.read()
+        salida = proceso.stdout.read()
+        _, estado, uso = os.wait4(proceso.pid, 0)
+        proceso.returncode = os.waitstatus_to_exitcode(estado)
+        rss_kb = uso.ru_maxrss // 1024 if sys.platform == 'darwin' else uso.ru_maxrss
+    else:
+        proceso = subprocess.Popen(comando, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+        salida, errores = proceso.communicate()  # En Windows no se mide la memoria
+    pared_us = int((time.monotonic() - inicio) * 1e6)
+
+    if proceso.returncode != 0:
+        return None, 'el programa termino con codigo %d' % proceso.returncode
+
+    resumen = None
+    for linea in errores.splitlines():
+        if linea.startswith('{"tipo":"resumen"'):
+            resumen = json.loads(linea)
+    if resumen is None:
+        return None, 'no se encontro la linea JSON de resumen'
+    if not resumen['completo']:
+        return None, 'la ejecucion no termino (se agoto el tiempo)'
+
+    medicion = {
+        'soluciones': resumen['soluciones'],
+        'nodos': resumen['nodos'],
+        'tiempo_us': resumen['tiempo_us'],
+        'pared_us': pared_us,
+        'nodos_por_s': resumen['nodos_por_s'],
+        'rss_kb': rss_kb,
+    }
+    return medicion, None
+
+
+# Compara el núcleo especializado de cada n con el genérico; devuelve el código de salida.
+def comparar_nucleos(programa, n_max, opciones, repeticiones):
+    print('n,nodos,generico_us,fijo_us,ganancia')
+    for n in range(N_MIN, n_max + 1):
+        mejor = {}
+        for nucleo in ('generico', 'fijo'):
+            for _ in range(repeticiones):
+                medicion, error = medir(programa, n, opciones + ['--nucleo', nucleo])
+                if error:
+                    print('ERROR: n=%d, nucleo %s: %s' % (n, nucleo, error))
+                    return 2
+                if medicion['soluciones'] != SUCESION[n - 1]:
+                    print('ERROR: n=%d, nucleo %s: se obtuvo %d y se esperaba %d'
+                          % (n, nucleo, medicion['soluciones'], SUCESION[n - 1]))
+                    return 2
+                if nucleo not in mejor or medicion['tiempo_us'] < mejor[nucleo]['tiempo_us']:
+                    mejor[nucleo] = medicion
+        generico, fijo = mejor['generico']['tiempo_us'], mejor['fijo']['tiempo_us']
+        print('%d,%d,%d,%d,%s' % (n, mejor['fijo']['nodos'], generico, fijo,
+                                  '%.3f' % (generico / fijo) if fijo > 0 else ''))
+    return 0
+
+
+# Corta y reanuda cada n desde un checkpoint; devuelve el código de salida.
+def comprobar_reanudacion(programa, n_max, opciones, hilos):
+    print('n,hilos,soluciones,esperado')
+    errores = 0
+    with tempfile.TemporaryDirectory() as carpeta:
+        checkpoint = os.path.join(carpeta, 'checkpoint.txt')
+        for n in range(N_MIN, n_max + 1):
+            comunes = ['--checkpoint', checkpoint, '--hilos', str(hilos)] + opciones
+            cortes = [[programa, str(n), '0'] + comunes]
+            cortes += [[programa, str(n), '0', '--resume', checkpoint] + comunes] * REANUDACIONES_CORTADAS
+            error = None
+            for comando in cortes:
+                if subprocess.run(comando, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL).returncode != 0:
+                    error = 'el programa termino con codigo distinto de 0 al cortar'
+                    break
+            if error is None:
+                medicion, error = medir(programa, n, ['--resume', checkpoint] + comunes)
+            if error:
+                print('ERROR: n=%d: %s' % (n, error))
+                errores += 1
+                continue
+            print('%d,%d,%d,%d' % (n, hilos, medicion['soluciones'], SUCESION[n - 1]))
+            if medicion['soluciones'] != SUCESION[n - 1]:
+                print('ERROR: n=%d: al reanudar se obtuvo %d y se esperaba %d'
+                      % (n, medicion['soluciones'], SUCESION[n - 1]))
+                errores += 1
+    return 2 if errores else 0
+
+
+# Lee el archivo de línea base (un diccionario de configuraciones) o uno vacío si no existe.
+def leer_base(nombre):
+    if not os.path.exists(nombre):
+        return {}
+    with open(nombre) as archivo:
+        return json.load(archivo)
+
+
+def main(argumentos):
+    programa = './programa'
+    nombre_base = 'benchmark_base.json'
+    grande = False
+    guardar = False
+    nucleos = False
+    reanudar = False
+    hilos = 2
+    repeticiones = 3
+    umbral = 0.8          # Falla si nodos/s < umbral * nodos/s de la base
+    tiempo_min_ms = 200   # Las ejecuciones más cortas que esto son muy ruidosas para comparar rendimiento
+    opciones = []
+
+    i = 0
+    while i < len(argumentos):
+        a = argumentos[i]
+        if a == '--':
+            opciones = argumentos[i + 1:]
+            break
+        elif a == '--grande':
+            grande = True
+        elif a == '--guardar':
+            guardar = True
+        elif a == '--nucleos':
+            nucleos = True
+        elif a == '--reanudar':
+            reanudar = True
+        elif a in ('--programa', '--base', '--umbral', '--tiempo_min', '--repeticiones', '--hilos') and i + 1 < len(argumentos):
+            i += 1
+            if a == '--programa':
+                programa = argumentos[i]
+            elif a == '--base':
+                nombre_base = argumentos[i]
+            elif a == '--umbral':
+                umbral = float(argumentos[i])
+            elif a == '--repeticiones':
+                repeticiones = max(1, int(argumentos[i]))
+            elif a == '--hilos':
+                hilos = max(1, int(argumentos[i]))
+            else:
+                tiempo_min_ms = int(argumentos[i])
+        else:
+            print('Uso: python benchmark.py [--programa ./programa] [--grande] [--base archivo.json] [--guardar]')
+            print('                         [--umbral fraccion] [--tiempo_min ms] [-- opciones para programa]')
+            print('       python benchmark.py --nucleos [--programa ./programa] [--grande] [--repeticiones r]')
+            print('                         [-- opciones para programa]')
+            print('       python benchmark.py --reanudar [--programa ./programa] [--grande] [--hilos h]')
+            print('                         [-- opciones para programa]')
+            return 1
+        i += 1
+
+    if nucleos:
+        return comparar_nucleos(programa, N_MAX_GRANDE if grande else N_MAX, opciones, repeticiones)
+    if reanudar:
+        return comprobar_reanudacion(programa, N_MAX_GRANDE if grande else N_MAX, opciones, hilos)
+
+    # Cada combinación de opciones del programa se mide y se compara por separado
+    configuracion = ' '.join(opciones) if opciones else '(por defecto)'
+    base = leer_base(nombre_base)
+    referencia = base.get(configuracion, {})
+    n_max = N_MAX_GRANDE if grande else N_MAX
+
+    mediciones = {}
+    errores = 0
+    regresiones = 0
+    print('configuracion: %s' % configuracion)
+    print('n,soluciones,esperado,nodos,tiempo_us,pared_us,nodos_por_s,rss_kb,relativo_a_base')
+    for n in range(N_MIN, n_max + 1):
+        medicion, error = medir(programa, n, opciones)
+        if error:
+            print('ERROR: n=%d: %s' % (n, error))
+            errores += 1
+            continue
+        mediciones[str(n)] = medicion
+
+        esperado = SUCESION[n - 1]
+        relativo = ''
+        anterior = referencia.get(str(n))
+        if anterior and anterior['nodos_por_s'] > 0:
+            relativo = '%.2f' % (medicion['nodos_por_s'] / anterior['nodos_por_s'])
+        print('%d,%d,%d,%d,%d,%d,%.0f,%s,%s' % (n, medicion['soluciones'], esperado, medicion['nodos'],
+                                               medicion['tiempo_us'], medicion['pared_us'], medicion['nodos_por_s'],
+                                               medicion['rss_kb'] if medicion['rss_kb'] is not None else '', relativo))
+
+        if medicion['soluciones'] != esperado:
+            print('ERROR: n=%d: se obtuvo %d y se esperaba %d' % (n, medicion['soluciones'], esperado))
+            errores += 1
+        # Sólo se compara el rendimiento cuando ambas ejecuciones duraron lo suficiente
+        elif (not guardar and anterior and medicion['tiempo_us'] >= tiempo_min_ms * 1000
+              and anterior['tiempo_us'] >= tiempo_min_ms * 1000
+              and medicion['nodos_por_s'] < umbral * anterior['nodos_por_s']):
+            print('REGRESION: n=%d: %.0f nodos/s frente a %.0f de la linea base (umbral %.2f)'
+                  % (n, medicion['nodos_por_s'], anterior['nodos_por_s'], umbral))
+            regresiones += 1
+
+    if errores:
+        return 2
+    if guardar:
+        base[configuracion] = mediciones
+        with open(nombre_base, 'w') as archivo:
+            json.dump(base, archivo, indent=2, sort_keys=True)
+        print('Linea base guardada en %s' % nombre_base)
+    elif not referencia:
+        print('No hay linea base para esta configuracion en %s (usar --guardar para crearla)' % nombre_base)
+    if regresiones:
+        return 3
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
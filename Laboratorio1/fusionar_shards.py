@@ -0,0 +1,121 @@
+# Fusión de los resultados de una ejecución repartida con --shard i/N.
+#
+# Uso:
+#   python fusionar_shards.py salida_0.txt salida_1.txt ...
+#       Lee las líneas "SHARD ..." que imprime programa.c en cada archivo, verifica que estén
+#       los N shards, que sean de la misma ejecución y que cubran todos los prefijos, y suma.
+#   python fusionar_shards.py --local N ./programa <numero> <tiempo en minutos> [opciones]
+#       Alternativa sin clúster: lanza los N shards como procesos locales y fusiona su salida.
+
+import subprocess
+import sys
+
+# Campos que deben coincidir entre todos los shards de una misma ejecución
+CAMPOS_COMUNES = ('n', 'simetria', 'profundidad', 'prefijos_totales')
+
+
+# Convierte una línea "SHARD i/N clave=valor ..." en un diccionario.
+def leer_registro(linea):
+    partes = linea.split()
+    i, total = partes[1].split('/')
+    registro = {'shard': int(i), 'num_shards': int(total)}
+    for campo in partes[2:]:
+        clave, valor = campo.split('=')
+        registro[clave] = int(valor)
+    return registro
+
+
+# Devuelve todos los registros de shard que aparezcan en un texto.
+def registros_de(texto, origen):
+    registros = []
+    for linea in texto.splitlines():
+        if linea.startswith('SHARD '):
+            registro = leer_registro(linea)
+            registro['origen'] = origen
+            registros.append(registro)
+    return registros
+
+
+# Verifica los registros y devuelve la lista de problemas encontrados (vacía si todo está bien).
+def verificar(registros):
+    if not registros:
+        return ['no se encontro ninguna linea SHARD']
+    problemas = []
+    num_shards = registros[0]['num_shards']
+    primero = registros[0]
+
+    vistos = {}
+    for r in registros:
+        if r['num_shards'] != num_shards:
+            problemas.append('%s: es de una particion en %d shards, no %d' % (r['origen'], r['num_shards'], num_shards))
+        for campo in CAMPOS_COMUNES:
+            if r[campo] != primero[campo]:
+                problemas.append('%s: %s=%d no coincide con %s=%d de %s'
+                                 % (r['origen'], campo, r[campo], campo, primero[campo], primero['origen']))
+        if r['shard'] in vistos:
+            problemas.append('shard %d repetido (%s y %s)' % (r['shard'], vistos[r['shard']], r['origen']))
+        vistos[r['shard']] = r['origen']
+        if not r['completo']:
+            problemas.append('%s: el shard %d no termino (reanudarlo con --resume)' % (r['origen'], r['shard']))
+
+        # Con reparto k % N == i, al shard i le tocan los prefijos i, i+N, i+2N, ...
+        esperados = (r['prefijos_totales'] - r['shard'] + num_shards - 1) // num_shards
+        if r['prefijos'] != esperados:
+            problemas.append('%s: el shard %d cubre %d prefijos y deberia cubrir %d'
+                             % (r['origen'], r['shard'], r['prefijos'], esperados))
+
+    faltantes = [i for i in range(num_shards) if i not in vistos]
+    if faltantes:
+        problemas.append('faltan los shards %s' % ', '.join(str(i) for i in faltantes))
+    return problemas
+
+
+# Lanza los N shards como procesos locales y devuelve sus registros.
+def lanzar_locales(num_shards, comando):
+    procesos = []
+    for i in range(num_shards):
+        argumentos = comando + ['--shard', '%d/%d' % (i, num_shards)]
+        procesos.append(subprocess.Popen(argumentos, stdout=subprocess.PIPE, universal_newlines=True))
+    registros = []
+    for i, proceso in enumerate(procesos):
+        salida, _ = proceso.communicate()
+        registros += registros_de(salida, 'proceso %d' % i)
+    return registros
+
+
+def main(argumentos):
+    if len(argumentos) >= 3 and argumentos[0] == '--local':
+        registros = lanzar_locales(int(argumentos[1]), argumentos[2:])
+    elif argumentos and not argumentos[0].startswith('--'):
+        registros = []
+        for nombre in argumentos:
+            with open(nombre) as archivo:
+                registros += registros_de(archivo.read(), nombre)
+    else:
+        print('Uso: python fusionar_shards.py <salida_shard> ...')
+        print('     python fusionar_shards.py --local <N> ./programa <numero> <tiempo en minutos> [opciones]')
+        return 1
+
+    problemas = verificar(registros)
+    if problemas:
+        for problema in problemas:
+            print('ERROR: ' + problema)
+        return 2
+
+    # Resumen por shard, para poder rebalancear (nodos y tiempo de cada uno)
+    registros.sort(key=lambda r: r['shard'])
+    print('shard,prefijos,soluciones,nodos,tiempo_us')
+    for r in registros:
+        print('%d,%d,%d,%d,%d' % (r['shard'], r['prefijos'], r['soluciones'], r['nodos'], r['tiempo_us']))
+
+    total = sum(r['soluciones'] for r in registros)
+    nodos = sum(r['nodos'] for r in registros)  # Los nodos de prefijo comunes solo los trae el shard 0
+    tiempos = [r['tiempo_us'] for r in registros]
+    print('El numero de permutaciones graciles de %d es: %d' % (registros[0]['n'], total))
+    print('Nodos: %d' % nodos)
+    print('Tiempo del shard mas lento: %d [us] (promedio %d [us])' % (max(tiempos), sum(tiempos) // len(tiempos)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,155 @@
+// Iterador de permutaciones gráciles con pila explícita (ver gp_iter.h).
+#include <stdlib.h>
+#include <string.h>
+#include "gp_iter.h"
+
+#define CABECERA_ITER "GP-ITER 1"
+
+// Posición del bit menos significativo en 1 (x no puede ser 0).
+static inline int ctz64(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long indice;
+    _BitScanForward64(&indice, x);
+    return (int)indice;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Estado inicial del nivel 0: todos los valores y todas las diferencias libres.
+static void iniciar_mascaras(gp_iter_t *it) {
+    int n = it->n;
+    it->libres[0] = ((1ULL << n) - 1) << 1;
+    it->difs[0] = ((1ULL << (n - 1)) - 1) << 1;
+    it->difs_inv[0] = ((1ULL << (n - 1)) - 1) << (64 - n);
+    it->difs_grandes = it->difs[0] & ~((1ULL << it->umbral) - 1);
+}
+
+// Candidatos legales del nivel pos (números libres a una distancia libre del último colocado).
+static inline uint64_t candidatos_de(const gp_iter_t *it, int pos) {
+    if (pos == 0) return it->libres[0];
+    int ultimo = it->perm[pos - 1];
+    return ((it->difs[pos] << ultimo) | (it->difs_inv[pos] >> (63 - ultimo))) & it->libres[pos];
+}
+
+// Máscaras del nivel pos+1 después de colocar 'num' en la posición pos.
+static inline void colocar(gp_iter_t *it, int pos, int num) {
+    int diff = (pos == 0) ? 0 : abs(num - it->perm[pos - 1]);  // La diferencia 0 nunca está en las máscaras
+    it->libres[pos + 1] = it->libres[pos] & ~(1ULL << num);
+    it->difs[pos + 1] = it->difs[pos] & ~(1ULL << diff);
+    it->difs_inv[pos + 1] = it->difs_inv[pos] & ~(1ULL << (63 - diff));
+}
+
+void gp_iter_init(gp_iter_t *it, int n, int umbral) {
+    memset(it, 0, sizeof(*it));
+    it->n = n;
+    it->umbral = (umbral <= 0 || umbral > n) ? n : umbral;
+    iniciar_mascaras(it);
+    it->pos = 0;
+    it->candidatos[0] = it->libres[0];  // El primer valor puede ser cualquiera
+    it->nodos[0] = 1;
+    it->expandidos[0] = 1;
+}
+
+/*Cada vuelta del ciclo toma el menor candidato pendiente del nivel en curso, cuenta el hijo y
+decide: si completa la permutación se entrega; si la poda por anticipación lo descarta se sigue
+con el hermano; si no, se apila como nuevo nivel con sus candidatos. Un nivel sin candidatos se
+desapila. Como el estado de cada nivel está en 'it', volver con GP_PAUSA o GP_SOLUCION no pierde nada.*/
+int gp_iter_next(gp_iter_t *it, int perm[], long long *nodos_restantes) {
+    int n = it->n;
+    int pos = it->pos;
+
+    while (pos >= 0) {
+        uint64_t c = it->candidatos[pos];
+        if (c == 0) {
+            pos--;  // Retroceso: el nivel ya no tiene candidatos
+            continue;
+        }
+        if (nodos_restantes != NULL && (*nodos_restantes)-- <= 0) {
+            *nodos_restantes = 0;
+            it->pos = pos;
+            return GP_PAUSA;
+        }
+        int num = ctz64(c);
+        it->candidatos[pos] = c & (c - 1);
+        it->perm[pos] = num;
+        colocar(it, pos, num);
+        it->nodos[pos + 1]++;
+
+        if (pos + 1 == n) {
+            memcpy(perm, it->perm, n * sizeof(int));
+            it->pos = pos;
+            return GP_SOLUCION;
+        }
+
+        // Poda por anticipación: cada diferencia grande libre necesita un par de valores que
+        // todavía puedan quedar vecinos (libres o el recién colocado).
+        uint64_t disponibles = it->libres[pos + 1] | (1ULL << num);
+        uint64_t grandes = it->difs[pos + 1] & it->difs_grandes;
+        while (grandes && (disponibles & (disponibles >> ctz64(grandes)))) grandes &= grandes - 1;
+        if (grandes) {
+            it->cortes_anticipacion[pos + 1]++;
+            continue;
+        }
+
+        pos++;
+        it->candidatos[pos] = candidatos_de(it, pos);
+        it->expandidos[pos]++;
+        if (it->candidatos[pos] == 0) it->sin_salida[pos]++;
+    }
+    it->pos = -1;
+    return GP_FIN;
+}
+
+unsigned long long gp_iter_nodos(const gp_iter_t *it) {
+    unsigned long long total = 0;
+    for (int d = 0; d <= it->n; d++) total += it->nodos[d];
+    return total;
+}
+
+/*Formato:
+    GP-ITER 1
+    <n> <umbral> <pos>
+    <perm[0]> ... <perm[pos-1]>
+    <candidatos[0]> ... <candidatos[pos]>     (en hexadecimal)
+    una línea por profundidad d = 0..n: <nodos> <expandidos> <sin_salida> <cortes_anticipacion>*/
+bool gp_iter_save(const gp_iter_t *it, FILE *f) {
+    fprintf(f, "%s\n%d %d %d\n", CABECERA_ITER, it->n, it->umbral, it->pos);
+    for (int k = 0; k < it->pos; k++) fprintf(f, "%s%d", k ? " " : "", it->perm[k]);
+    fputc('\n', f);
+    for (int k = 0; k <= it->pos; k++) fprintf(f, "%s%llx", k ? " " : "", (unsigned long long)it->candidatos[k]);
+    fputc('\n', f);
+    for (int d = 0; d <= it->n; d++)
+        fprintf(f, "%llu %llu %llu %llu\n", it->nodos[d], it->expandidos[d], it->sin_salida[d], it->cortes_anticipacion[d]);
+    return !ferror(f);
+}
+
+bool gp_iter_load(gp_iter_t *it, FILE *f) {
+    char cabecera[32];
+    int n, umbral, pos;
+    if (fgets(cabecera, sizeof(cabecera), f) == NULL || strncmp(cabecera, CABECERA_ITER, strlen(CABECERA_ITER)) != 0
+        || fscanf(f, "%d %d %d", &n, &umbral, &pos) != 3 || n < 1 || n > GP_MAX_N || pos < -1 || pos >= n)
+        return false;
+    gp_iter_init(it, n, umbral);
+    it->pos = pos;
+
+    // El prefijo tiene que ser válido: se reconstruyen las máscaras nivel por nivel y se verifican.
+    for (int k = 0; k < pos; k++) {
+        int v;
+        if (fscanf(f, "%d", &v) != 1 || v < 1 || v > n || !(it->libres[k] & (1ULL << v))) return false;
+        if (k > 0 && !(it->difs[k] & (1ULL << abs(v - it->perm[k - 1])))) return false;
+        it->perm[k] = v;
+        colocar(it, k, v);
+    }
+    for (int k = 0; k <= pos; k++) {
+        unsigned long long c;
+        if (fscanf(f, "%llx", &c) != 1 || (c & ~candidatos_de(it, k))) return false;
+        it->candidatos[k] = c;
+    }
+    for (int d = 0; d <= n; d++) {
+        if (fscanf(f, "%llu %llu %llu %llu", &it->nodos[d], &it->expandidos[d], &it->sin_salida[d],
+                   &it->cortes_anticipacion[d]) != 4)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+// Iterador de permutaciones gráciles de 1..n con pila explícita.
+/*Recorre el mismo árbol que backtrack_bits de programa.c (máscaras de 64 bits y poda por anticipación),
+pero sin recursión: todo el estado de la búsqueda está en gp_iter_t, así que se puede detener en
+cualquier momento, guardar en un archivo y continuar después, incluso en otro proceso.
+
+Uso típico:
+    gp_iter_t it;
+    int perm[GP_MAX_N];
+    gp_iter_init(&it, n, n / 2);
+    while (gp_iter_next(&it, perm, NULL) == GP_SOLUCION) usar(perm);
+
+Con un presupuesto de nodos, gp_iter_next vuelve con GP_PAUSA cuando se agota, para que quien lo
+llama revise el reloj; la siguiente llamada sigue exactamente desde ahí.*/
+#ifndef GP_ITER_H
+#define GP_ITER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GP_MAX_N 50  // Mayor n aceptado (las máscaras son de 64 bits)
+
+// Resultados de gp_iter_next
+#define GP_SOLUCION 0  // perm[] tiene la siguiente permutación grácil
+#define GP_FIN 1  // Ya se recorrió todo el árbol
+#define GP_PAUSA 2  // Se agotó el presupuesto de nodos; volver a llamar para seguir
+
+typedef struct {
+    int n;
+    int pos;  // Nivel en curso: cantidad de valores colocados (-1 cuando terminó)
+    int perm[GP_MAX_N + 1];  // Permutación parcial
+    uint64_t candidatos[GP_MAX_N + 1];  // Candidatos aún no explorados en cada nivel
+    uint64_t libres[GP_MAX_N + 1];  // Valores libres en cada nivel (bit v)
+    uint64_t difs[GP_MAX_N + 1];  // Diferencias libres en cada nivel (bit d)
+    uint64_t difs_inv[GP_MAX_N + 1];  // Las mismas diferencias reflejadas (bit 63-d)
+    uint64_t difs_grandes;  // Diferencias que revisa la poda por anticipación
+    int umbral;  // Menor diferencia revisada por la poda por anticipación (n: sin poda)
+
+    // Contadores por profundidad, con el mismo significado que en estadisticas_t de programa.c
+    unsigned long long nodos[GP_MAX_N + 2];
+    unsigned long long expandidos[GP_MAX_N + 2];
+    unsigned long long sin_salida[GP_MAX_N + 2];
+    unsigned long long cortes_anticipacion[GP_MAX_N + 2];
+} gp_iter_t;
+
+// Prepara el iterador para recorrer las permutaciones gráciles de 1..n (1 <= n <= GP_MAX_N).
+// 'umbral' es la menor diferencia que revisa la poda por anticipación; 0 la desactiva.
+void gp_iter_init(gp_iter_t *it, int n, int umbral);
+
+// Avanza hasta la siguiente permutación grácil y la copia en perm[0..n-1].
+// Si 'nodos_restantes' no es NULL, se descuenta un nodo por cada nodo visitado y al llegar a 0
+// se devuelve GP_PAUSA (el contador se puede recargar antes de volver a llamar).
+int gp_iter_next(gp_iter_t *it, int perm[], long long *nodos_restantes);
+
+// Total de nodos visitados hasta ahora.
+unsigned long long gp_iter_nodos(const gp_iter_t *it);
+
+// Guarda el estado del iterador como texto. Las máscaras no se guardan: se reconstruyen al cargar.
+bool gp_iter_save(const gp_iter_t *it, FILE *f);
+
+// Carga un estado guardado con gp_iter_save. Devuelve false si el archivo no es válido.
+bool gp_iter_load(gp_iter_t *it, FILE *f);
+
+#endif
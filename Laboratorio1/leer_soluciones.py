@@ -0,0 +1,132 @@
+# Lectura de los archivos binarios que escribe programa.c con --emit.
+#
+# Uso:
+#   python leer_soluciones.py archivo.bin
+#       Muestra la cabecera (n, soluciones, bloques, tamaño por registro).
+#   python leer_soluciones.py archivo.bin <i> [<j>]
+#       Imprime las soluciones i..j-1 (o solo la i), yendo directo a su bloque con el índice.
+#   python leer_soluciones.py archivo.bin --verificar
+#       Decodifica todo y verifica que cada registro sea una permutación grácil, que no haya
+#       repetidos y que el total coincida con la cabecera.
+#
+# El formato está descrito en programa.c, junto a salida_t.
+
+import struct
+import sys
+
+CABECERA = 64
+
+
+# Lee la cabecera y el índice; devuelve (datos, diccionario con la cabecera, lista de bloques).
+def abrir(nombre):
+    with open(nombre, 'rb') as archivo:
+        datos = archivo.read()
+    if len(datos) < CABECERA or datos[:8] != b'GRACEMIT':
+        raise ValueError('%s no es un archivo de --emit' % nombre)
+    version, n, bits, banderas = struct.unpack_from('<IIII', datos, 8)
+    soluciones, por_bloque, num_bloques, indice = struct.unpack_from('<QQQQ', datos, 24)
+    if version != 1:
+        raise ValueError('version %d desconocida' % version)
+    cabecera = {'n': n, 'bits': bits, 'delta': bool(banderas & 1), 'completo': not (banderas & 2),
+                'soluciones': soluciones, 'por_bloque': por_bloque, 'bloques': num_bloques, 'indice': indice}
+    bloques = [struct.unpack_from('<QQ', datos, indice + 16 * b) for b in range(num_bloques)]
+    return datos, cabecera, bloques
+
+
+# Genera los registros de un bloque: 'cuantos' permutaciones a partir del byte 'inicio'.
+def decodificar_bloque(datos, cabecera, inicio, cuantos):
+    n, bits = cabecera['n'], cabecera['bits']
+    mascara = (1 << bits) - 1
+    acumulador, disponibles, posicion = 0, 0, inicio
+
+    def leer():
+        nonlocal acumulador, disponibles, posicion
+        while disponibles < bits:
+            acumulador |= datos[posicion] << disponibles
+            posicion += 1
+            disponibles += 8
+        valor = acumulador & mascara
+        acumulador >>= bits
+        disponibles -= bits
+        return valor
+
+    anterior = [0] * n
+    for k in range(cuantos):
+        comun = leer() if cabecera['delta'] and k > 0 else 0
+        perm = anterior[:comun] + [leer() + 1 for _ in range(n - comun)]
+        anterior = perm
+        yield perm
+
+
+# Número de registros de cada bloque (el siguiente empieza donde termina este).
+def tamanos(cabecera, bloques):
+    primeros = [primero for _, primero in bloques] + [cabecera['soluciones']]
+    return [primeros[b + 1] - primeros[b] for b in range(len(bloques))]
+
+
+# Soluciones i..j-1, decodificando solo desde el bloque que contiene a i.
+def rango(datos, cabecera, bloques, i, j):
+    cuantos = tamanos(cabecera, bloques)
+    resultado = []
+    b = 0
+    while b + 1 < len(bloques) and bloques[b + 1][1] <= i:
+        b += 1
+    while b < len(bloques) and len(resultado) < j - i:
+        desplazamiento, primero = bloques[b]
+        for k, perm in enumerate(decodificar_bloque(datos, cabecera, desplazamiento, cuantos[b])):
+            if i <= primero + k < j:
+                resultado.append(perm)
+        b += 1
+    return resultado
+
+
+def es_gracil(perm):
+    n = len(perm)
+    return (sorted(perm) == list(range(1, n + 1))
+            and sorted(abs(perm[k + 1] - perm[k]) for k in range(n - 1)) == list(range(1, n)))
+
+
+def verificar(datos, cabecera, bloques):
+    vistas = set()
+    problemas = 0
+    for (desplazamiento, _), cuantos in zip(bloques, tamanos(cabecera, bloques)):
+        for perm in decodificar_bloque(datos, cabecera, desplazamiento, cuantos):
+            clave = tuple(perm)
+            if not es_gracil(perm):
+                print('ERROR: %s no es gracil' % ' '.join(map(str, perm)))
+                problemas += 1
+            elif clave in vistas:
+                print('ERROR: %s esta repetida' % ' '.join(map(str, perm)))
+                problemas += 1
+            vistas.add(clave)
+    if len(vistas) != cabecera['soluciones']:
+        print('ERROR: hay %d soluciones distintas y la cabecera dice %d' % (len(vistas), cabecera['soluciones']))
+        problemas += 1
+    print('%d soluciones verificadas, %d problemas' % (len(vistas), problemas))
+    return 0 if problemas == 0 else 2
+
+
+def main(argumentos):
+    if not argumentos:
+        print('Uso: python leer_soluciones.py <archivo> [<i> [<j>] | --verificar]')
+        return 1
+    datos, cabecera, bloques = abrir(argumentos[0])
+    if len(argumentos) == 1:
+        print('n=%d soluciones=%d bloques=%d bits=%d delta=%s completo=%s bytes_por_registro=%.2f'
+              % (cabecera['n'], cabecera['soluciones'], cabecera['bloques'], cabecera['bits'], cabecera['delta'],
+                 cabecera['completo'], (len(datos) - CABECERA) / max(cabecera['soluciones'], 1)))
+        return 0
+    if argumentos[1] == '--verificar':
+        return verificar(datos, cabecera, bloques)
+    i = int(argumentos[1])
+    j = int(argumentos[2]) if len(argumentos) > 2 else i + 1
+    if not 0 <= i < j <= cabecera['soluciones']:
+        print('Las soluciones van de 0 a %d' % (cabecera['soluciones'] - 1))
+        return 1
+    for perm in rango(datos, cabecera, bloques, i, j):
+        print(' '.join(map(str, perm)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
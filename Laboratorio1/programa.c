@@ -1,108 +1,2829 @@
+// Conteo de permutaciones gráciles de 1..n por backtracking.
+// Compilar: make (o gcc -O2 -pthread programa.c gp_iter.c -o programa -lm)
+// Solo POSIX: usa pthreads, clock_gettime y rename atómico (en Windows, bajo WSL o Cygwin).
+#ifdef __linux__
+#define _GNU_SOURCE  // F_SETSIG y F_SETOWN_EX de fcntl, para las señales de --perf
+#endif
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <windows.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <math.h>
+#include "gp_iter.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // __rdtsc para el motor de carriles
+#endif
 
-#define DEBUG  // Definición para habilitar depuración si es necesario
+#include <time.h>  // clock_gettime con CLOCK_MONOTONIC
+
+// Contadores de rendimiento del procesador (--perf): solo en Linux, con perf_event_open.
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Límites del ajuste automático del número de nodos entre revisiones del reloj.
+#define NODOS_REVISION_MAX (1LL << 24)
+#define HOLGURA_POR_DEFECTO_MS 10
+
+// Motores de búsqueda disponibles (se eligen con --motor)
+#define MOTOR_CLASICO 0  // Arreglos bool usado[] / diferencias[] y recorrido de 1..n
+#define MOTOR_BITS 1     // Máscaras de 64 bits y recorrido de candidatos con ctz
+#define MOTOR_ITERATIVO 2  // Las mismas máscaras con pila explícita (gp_iter.c), un solo hilo
+#define MOTOR_MITAD 3  // Encuentro a mitad de camino: mitades unidas por firma en una tabla hash
+#define MOTOR_DIFERENCIAS 4  // Asigna las diferencias de mayor a menor como aristas de un camino
+#define MOTOR_CARRILES 5  // Varios subárboles a la vez en los carriles de un registro vectorial
+
+#define CABECERA_CACHE "GRACILES-CACHE 3"
+#define MAX_N 50  // Mayor n aceptado por main()
+#define MAX_HILOS 256
+#define PROFUNDIDAD_POR_DEFECTO 3  // Profundidad a la que se parte el árbol en tareas
+#define INTERVALO_CHECKPOINT_POR_DEFECTO 60  // Segundos entre dos checkpoints
+#define CABECERA_CHECKPOINT "GRACILES-CHECKPOINT 1"
+#define CABECERA_CHECKPOINT_ITER "GRACILES-CHECKPOINT-ITER 1"  // Checkpoint de --motor iterativo
+#define INTERVALO_PROGRESO_POR_DEFECTO 10  // Segundos entre dos líneas de progreso en stderr
+#define TIEMPO_CALIBRACION_US 300000  // Búsqueda real que mide la velocidad en --estimate
+#define COLA_ESTIMACION 6  // Niveles finales que cada sondeo de --estimate cuenta completos
+#define MEM_MITAD_POR_DEFECTO_MB 256  // Memoria de la tabla de firmas del motor mitad
+#define PARTICIONES_MITAD 64  // Archivos temporales por lado cuando las firmas no caben en memoria
+#define HOJAS_MUESTREO 64  // Uno de cada tantos subárboles del núcleo de hojas se recorre para medir lo ahorrado
+#define GRADOS_MUESTREO 64  // Uno de cada tantos cortes de --grados se recorre para medir lo ahorrado
+#define EVENTOS_PERF 5  // Contadores que lee --perf (ver nombres_perf)
+#define BANDAS_PERF 4  // Bandas de profundidad en que --perf reparte el árbol del motor de bits
+#define HOJAS_ORDENES_MAX (1 << 25)  // Órdenes que se recorren como máximo al llenar la tabla del núcleo
+#define SALIDA_BUFFER (1 << 20)  // Bytes del buffer de --emit de cada hilo
+#define SALIDA_POR_BLOQUE 4096  // Registros por bloque del índice de --emit
+#define SALIDA_CABECERA 64  // Bytes de la cabecera del archivo de --emit
+#define MEMO_VIAS 2  // Entradas por cubeta de la tabla de transposición
+#define MEMO_POS_MIN 5  // Antes de esta profundidad casi no se repiten estados
+#define MEMO_RESTANTES_MIN 9  // Subárboles con menos posiciones libres cuestan menos que la consulta
+#define MEMO_ORDEN_POR_DEFECTO_MB 64  // Tabla de cuentas de --sample y --unrank si no se da --memo
+#define MEMO_ORDEN_TODO_MAX 14  // Hasta este n la tabla de --sample y --unrank guarda todo subárbol (cabe entera)
+
+// Revisión amortizada del tiempo límite
+/*Leer el reloj en cada nodo cuesta más que el propio nodo, por eso el reloj solo se consulta
+cada 'nodos_por_revision' nodos. Ese número se ajusta solo para que entre dos revisiones pase
+como máximo la mitad de 'holgura_us', así el sobrepaso sobre tiempo_limite queda acotado por la holgura.
+Cada hilo de búsqueda lleva su propio presupuesto.*/
+typedef struct {
+    long long nodos_por_revision;  // Nodos que se visitan entre dos lecturas del reloj
+    long long nodos_restantes;  // Cuenta regresiva hasta la próxima lectura del reloj
+    long long ultima_revision;  // Instante (us) de la última lectura del reloj
+} presupuesto_t;
+
+// Estadísticas de la búsqueda, por profundidad (número de valores ya colocados)
+/*Rechazos: candidatos que el motor clásico descarta en el bucle 1..n, separados por la condición
+que los descarta. El motor de bits no recorre los descartados, así que sus rechazos se deducen al
+final: en un nodo expandido a profundidad d se descartan d números usados y (n-d) - hijos por
+diferencia usada, y nunca hay diferencias fuera de rango.*/
+typedef struct {
+    unsigned long long nodos[MAX_N + 2];  // Nodos visitados
+    unsigned long long expandidos[MAX_N + 2];  // Nodos que generaron candidatos (no hojas ni cortados)
+    unsigned long long sin_salida[MAX_N + 2];  // Expandidos sin ningún candidato válido
+    unsigned long long rechazo_usado[MAX_N + 2];  // usado[num]
+    unsigned long long rechazo_fuera[MAX_N + 2];  // diff < 1 || diff >= n
+    unsigned long long rechazo_dif[MAX_N + 2];  // diferencias[diff]
+    unsigned long long cortes_simetria[MAX_N + 2];  // Nodos descartados por --simetria
+    unsigned long long cortes_anticipacion[MAX_N + 2];  // Nodos descartados porque una diferencia grande ya no cabe
+    unsigned long long cortes_grados[MAX_N + 2];  // Nodos descartados porque un valor libre se quedó sin vecinos (--grados)
+} estadisticas_t;
 
 // Variables globales
-int contador = 0;  // Contador de permutaciones gráciles encontradas
-LARGE_INTEGER comienzo, frecuencia;  // Variables para medir el tiempo de ejecución
+unsigned long long contador = 0;  // Contador de permutaciones gráciles encontradas
+unsigned long long nodos_visitados = 0;  // Nodos del árbol recorridos por el motor de bits
+long long comienzo;  // Instante de inicio de la ejecución en microsegundos
 long long tiempo_limite;  // Límite de tiempo en microsegundos
-bool tiempo_agotado = false;  // Bandera para indicar si el tiempo se agotó
+atomic_bool tiempo_agotado = false;  // Bandera para indicar si el tiempo se agotó (compartida por todos los hilos)
+int motor = MOTOR_BITS;  // Motor de búsqueda seleccionado
+const char *nombres_motor[] = {"clasico", "bits", "iterativo", "mitad", "diferencias", "carriles"};
+// Versión del recorrido de cada motor: se sube cuando cambia lo que visita, para que la cache de
+// resultados no mezcle sus nodos con los de la versión anterior y lo valide contra ella.
+const int versiones_motor[] = {1, 1, 1, 1, 1, 1};
+int hilos = 1;  // Número de hilos de búsqueda del motor de bits
+int profundidad_division = PROFUNDIDAD_POR_DEFECTO;  // Longitud de los prefijos iniciales
+bool simetria = false;  // Buscar solo representantes canónicos bajo inversión y complemento
+bool comprobar = false;  // Comparar el resultado con la fuerza bruta (n pequeños)
+bool listar = false;  // Imprimir cada permutación encontrada (motor iterativo)
+FILE *diagnosticos;  // Avisos de los motores: stdout, o stderr cuando stdout lleva datos (--range, --listar)
+long long sondeos = 0;  // Sondeos aleatorios de --estimate (0: contar de verdad)
+long long muestras_pedidas = 0;  // Permutaciones al azar de --sample (0: ninguna)
+unsigned long long indice_pedido = 0;  // Índice lexicográfico de --unrank
+bool pedir_indice = false;  // Se dio --unrank
+uint64_t semilla_muestras = 0;  // Semilla de --sample dada con --semilla
+bool semilla_dada = false;
+const char *archivo_checkpoint = NULL;  // Dónde guardar la frontera de la búsqueda (--checkpoint)
+const char *archivo_reanudar = NULL;  // Checkpoint desde el que se continúa (--resume)
+long long intervalo_checkpoint_us = INTERVALO_CHECKPOINT_POR_DEFECTO * 1000000LL;
+long long tiempo_previo_us = 0;  // Tiempo ya gastado en ejecuciones anteriores (al reanudar)
+long long tareas_en_frontera = 0;  // Subárboles pendientes que quedaron en el último checkpoint
+
+// Reparto determinista entre procesos (--shard i/N)
+/*Los prefijos de longitud 'profundidad' se generan siempre en el mismo orden (lexicográfico), y el
+shard i se queda con los de índice k tal que k % N == i. Así cada proceso cuenta su parte sin
+compartir nada, y fusionar_shards.py suma los resultados y verifica que no falte ninguno.*/
+int shard = 0, num_shards = 1;
+long long prefijos_totales = 0;  // Prefijos generados en todo el espacio
+long long prefijos_propios = 0;  // Prefijos que le tocaron a este shard
+long long holgura_us = HOLGURA_POR_DEFECTO_MS * 1000LL;  // Sobrepaso máximo permitido sobre el límite
+presupuesto_t presupuesto_global;  // Presupuesto de nodos del motor clásico
+estadisticas_t estadisticas;  // Estadísticas totales de la ejecución (las del motor clásico se llevan aquí directamente)
+long long intervalo_progreso_us = INTERVALO_PROGRESO_POR_DEFECTO * 1000000LL;  // 0: sin líneas de progreso
+int umbral_anticipacion = -1;  // Menor diferencia que revisa la poda por anticipación (-1: n/2, 0: sin poda)
+long long mem_mitad_bytes = MEM_MITAD_POR_DEFECTO_MB * 1024LL * 1024LL;  // Límite de la tabla del motor mitad
+long long memo_bytes = 0;  // Memoria total de las tablas de transposición (0: sin --memo)
+const char *archivo_emit = NULL;  // Archivo binario con todas las soluciones (--emit)
+bool salida_delta = false;  // Registros con prefijo compartido (--emit_delta)
+unsigned long long registros_emitidos = 0, bytes_emitidos = 0;
+int hojas_k = 0;  // Valores libres a partir de los que se usa el núcleo de hojas (0: sin --hojas)
+int rango_desde = 0, rango_hasta = 0;  // Barrido de --range (0: un solo n)
+const char *archivo_cache = NULL;  // Resultados ya calculados (--cache)
+int poda_grados = 0;  // Cada cuántos niveles se aplica la poda por grados (0: sin --grados)
+double nodos_ahorrados_grados = 0;  // Estimación de los nodos que la poda por grados evitó visitar
+bool nucleo_fijo = true;  // Usar el núcleo especializado para el n de cada tarea (--nucleo)
+bool medir_perf = false;  // Leer los contadores del procesador alrededor de la búsqueda (--perf)
+long long ultimo_progreso;  // Instante de la última línea de progreso
+unsigned long long nodos_ultimo_progreso;  // Nodos contados en la última línea de progreso
+
+// Función que devuelve un instante en microsegundos de un reloj monotónico.
+long long reloj_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Función que reinicia un presupuesto de nodos para que revise el reloj en el primer nodo.
+void iniciar_presupuesto(presupuesto_t *p) {
+    p->nodos_por_revision = 1;
+    p->nodos_restantes = 1;
+    p->ultima_revision = reloj_us();
+}
+
+// Función que lee el reloj, marca tiempo_agotado si se alcanzó el límite y
+// recalcula cuántos nodos visitar antes de la siguiente lectura.
+void revisar_tiempo(presupuesto_t *p) {
+    long long actual = reloj_us();
+
+    // Verifica si el tiempo límite se ha alcanzado.
+    if (actual - comienzo >= tiempo_limite) {
+        tiempo_agotado = true;
+        return;
+    }
+
+    // Ajuste del intervalo: se busca que entre revisiones pase holgura_us / 2.
+    // El crecimiento se limita al doble por paso para no saltarse el límite si la velocidad cambia.
+    long long objetivo = holgura_us / 2;
+    long long transcurrido = actual - p->ultima_revision;
+    long long siguiente;
+    if (transcurrido <= 0) {
+        siguiente = p->nodos_por_revision * 2;
+    } else {
+        siguiente = p->nodos_por_revision * objetivo / transcurrido;
+        if (siguiente > p->nodos_por_revision * 2) siguiente = p->nodos_por_revision * 2;
+    }
+    if (siguiente < 1) siguiente = 1;
+    if (siguiente > NODOS_REVISION_MAX) siguiente = NODOS_REVISION_MAX;
+
+    p->nodos_por_revision = siguiente;
+    p->nodos_restantes = siguiente;
+    p->ultima_revision = actual;
+}
+
+// Contadores del procesador (--perf)
+/*Cada hilo abre con perf_event_open un grupo de contadores que cuenta solo a ese hilo y solo en modo
+usuario: el reloj del hilo (task-clock, por software, siempre está) como líder, y los de hardware
+que la máquina tenga (muchas máquinas virtuales no tienen ninguno). El grupo se lee entero con un
+read() al principio y al final: eso da los totales exactos.
+Para repartirlos por profundidad no se puede leer en cada nodo (un read() cuesta más que el nodo, y
+medir subárboles pequeños con lecturas sueltas los hace parecer más lentos de lo que son). En su lugar
+cada contador avisa con la señal SENAL_PERF cada periodos_perf[e] eventos, y el manejador anota la
+banda en que estaba el hilo en ese momento. Cada banda se queda con la parte del total que le
+corresponde según sus muestras.*/
+enum { PERF_RELOJ, PERF_CICLOS, PERF_INSTRUCCIONES, PERF_FALLOS_SALTO, PERF_FALLOS_L1 };
+const char *nombres_perf[EVENTOS_PERF] = {"reloj_ns", "ciclos", "instrucciones", "fallos_salto", "fallos_l1"};
+// Eventos entre dos muestras: 100 us de reloj, un millón de ciclos o instrucciones, 10000 fallos.
+const unsigned long long periodos_perf[EVENTOS_PERF] = {100000, 1000000, 1000000, 10000, 10000};
+
+typedef struct {
+    int lider;  // Descriptor que se lee (-1: sin contadores)
+    int descriptores[EVENTOS_PERF];  // -1: evento no disponible
+    int indice[EVENTOS_PERF];  // Lugar de cada evento en la lectura del grupo
+    volatile int banda;  // Banda de profundidad en que está el hilo (0: fuera de los subárboles de tareas)
+    unsigned long long muestras[BANDAS_PERF + 1][EVENTOS_PERF];  // Avisos de cada contador en cada banda
+} contadores_t;
+
+_Thread_local contadores_t *contadores_hilo = NULL;  // Los contadores del hilo que recibe la señal
+
+#ifdef __linux__
+#define SENAL_PERF (SIGRTMIN + 1)
+
+// Manejador de SENAL_PERF: si_fd dice qué contador desbordó.
+static void al_desbordar(int senal, siginfo_t *info, void *contexto) {
+    (void)senal;
+    (void)contexto;
+    contadores_t *c = contadores_hilo;
+    if (c == NULL) return;
+    for (int e = 0; e < EVENTOS_PERF; e++)
+        if (c->descriptores[e] == info->si_fd) c->muestras[c->banda][e]++;
+}
+
+static int abrir_evento(uint32_t tipo, uint64_t config, int lider, unsigned long long periodo) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = tipo;
+    a.config = config;
+    a.sample_period = periodo;
+    a.disabled = lider < 0;  // El grupo arranca detenido y se activa entero cuando está armado
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_GROUP;
+    int fd = (int)syscall(SYS_perf_event_open, &a, 0, -1, lider, 0);
+    if (fd < 0) return fd;
+
+    // El aviso de cada desborde llega como SENAL_PERF a este mismo hilo.
+    struct f_owner_ex dueno = {F_OWNER_TID, (pid_t)syscall(SYS_gettid)};
+    fcntl(fd, F_SETFL, O_ASYNC);
+    fcntl(fd, F_SETSIG, SENAL_PERF);
+    fcntl(fd, F_SETOWN_EX, &dueno);
+    return fd;
+}
+#endif
+
+// Lee los contadores del grupo; los eventos que no están quedan en 0.
+void perf_leer(const contadores_t *c, double valores[EVENTOS_PERF]) {
+    for (int e = 0; e < EVENTOS_PERF; e++) valores[e] = 0;
+#ifdef __linux__
+    uint64_t buffer[EVENTOS_PERF + 1];  // Cantidad de eventos y un valor por evento
+    if (c->lider >= 0 && read(c->lider, buffer, sizeof(buffer)) > 0) {
+        for (int e = 0; e < EVENTOS_PERF; e++)
+            if (c->descriptores[e] >= 0 && (uint64_t)c->indice[e] < buffer[0]) valores[e] = (double)buffer[1 + c->indice[e]];
+    }
+#endif
+}
+
+// Abre los contadores del hilo que llama. Devuelve false si no se pudo abrir ni el reloj.
+bool perf_abrir(contadores_t *c) {
+    memset(c, 0, sizeof(*c));
+    c->lider = -1;
+    for (int e = 0; e < EVENTOS_PERF; e++) c->descriptores[e] = -1;
+#ifdef __linux__
+    const uint32_t tipos[EVENTOS_PERF] = {PERF_TYPE_SOFTWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                          PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    const uint64_t configs[EVENTOS_PERF] = {
+        PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8
+            | (uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16};
+    struct sigaction accion;
+    memset(&accion, 0, sizeof(accion));
+    accion.sa_sigaction = al_desbordar;
+    accion.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(SENAL_PERF, &accion, NULL);
+
+    int abiertos = 0;
+    for (int e = 0; e < EVENTOS_PERF; e++) {
+        int fd = abrir_evento(tipos[e], configs[e], c->lider, periodos_perf[e]);
+        if (fd < 0) {
+            if (e == PERF_RELOJ) return false;
+            continue;  // Sin ese contador de hardware: se informa como no disponible
+        }
+        if (c->lider < 0) c->lider = fd;
+        c->descriptores[e] = fd;
+        c->indice[e] = abiertos++;
+    }
+    contadores_hilo = c;
+    ioctl(c->lider, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void perf_cerrar(contadores_t *c) {
+    contadores_hilo = NULL;
+#ifdef __linux__
+    for (int e = 0; e < EVENTOS_PERF; e++)
+        if (c->descriptores[e] >= 0) close(c->descriptores[e]);
+#endif
+    c->lider = -1;
+}
+
+// Suma a 'total' lo contado entre 'antes' y 'despues'.
+void perf_acumular(const double antes[], const double despues[], double total[]) {
+    for (int e = 0; e < EVENTOS_PERF; e++) total[e] += despues[e] - antes[e];
+}
+
+// Función que calcula el factorial de un número entero positivo n.
+unsigned long long factorial(int n) {
+    // Variable para almacenar el resultado del factorial.
+    // Se usa 'unsigned long long' porque los valores factoriales pueden ser grandes.
+    unsigned long long resultado = 1;
+
+    // Bucle que multiplica desde 2 hasta n.
+    // Se omite multiplicar por 1 porque no cambia el resultado.
+    for (int i = 2; i <= n; i++) {
+        resultado *= i; // Acumulación del producto factorial.
+    }
+
+    return resultado; // Devuelve el valor final de n!
+}
+
+// Telemetría
+/*Mientras corre la búsqueda se escribe en stderr una línea JSON de progreso cada
+'intervalo_progreso_us', y al final una línea JSON de resumen con los contadores por profundidad.
+benchmark.py usa la línea de resumen para verificar los conteos y medir el rendimiento.*/
+void emitir_progreso(unsigned long long nodos, unsigned long long soluciones, long long pendientes) {
+    long long ahora = reloj_us();
+    long long dt = ahora - ultimo_progreso;
+    double nodos_por_s = dt > 0 ? (double)(nodos - nodos_ultimo_progreso) * 1e6 / dt : 0.0;
+    fprintf(stderr, "{\"tipo\":\"progreso\",\"t_us\":%lld,\"nodos\":%llu,\"soluciones\":%llu,"
+            "\"nodos_por_s\":%.0f,\"tareas_pendientes\":%lld}\n",
+            ahora - comienzo, nodos, soluciones, nodos_por_s, pendientes);
+    fflush(stderr);
+    ultimo_progreso = ahora;
+    nodos_ultimo_progreso = nodos;
+}
+
+// El motor clásico corre en el hilo principal: emite el progreso desde su propia revisión del reloj.
+void emitir_progreso_clasico(void) {
+    if (intervalo_progreso_us == 0 || presupuesto_global.ultima_revision - ultimo_progreso < intervalo_progreso_us) return;
+    unsigned long long nodos = 0;
+    for (int d = 0; d <= MAX_N; d++) nodos += estadisticas.nodos[d];
+    emitir_progreso(nodos, contador, -1);
+}
+
+// Función recursiva que implementa el algoritmo de backtracking con poda.
+// Parámetros:
+// - perm[]: Arreglo que almacena la permutación parcial construida.
+// - usado[]: Arreglo booleano que indica qué números ya han sido utilizados en la permutación actual.
+// - diferencias[]: Arreglo booleano que marca qué diferencias entre elementos consecutivos ya han aparecido.
+// - n: Tamaño de la permutación a generar.
+// - pos: Índice actual dentro de la permutación.
+void backtrack(int perm[], bool usado[], bool diferencias[], int n, int pos) {
+    
+    // El reloj solo se consulta cuando se termina el presupuesto de nodos (ver revisar_tiempo).
+    if (--presupuesto_global.nodos_restantes == 0) {
+        revisar_tiempo(&presupuesto_global);
+        if (tiempo_agotado) return;  // Finaliza la ejecución de esta rama de búsqueda.
+        emitir_progreso_clasico();
+    }
+    estadisticas.nodos[pos]++;
+    
+    // Caso base: Si hemos llenado toda la permutación, contamos esta como válida.
+    // Cuando pos == n, significa que hemos colocado n números en perm[], es decir, 
+    // hemos generado una permutación completa.
+    if (pos == n) {
+        contador++;  // Incrementa el contador de permutaciones válidas.
+        return;  // Finaliza esta rama de la recursión.
+    }
+
+    // Poda por anticipación (ver backtrack_bits): cada diferencia grande sin usar necesita un par
+    // {a, a+d} de valores que todavía puedan quedar vecinos (libres o el último colocado).
+    if (pos > 0) {
+        for (int d = n - 1; d >= umbral_anticipacion; d--) {
+            if (diferencias[d]) continue;
+            int a = 1;
+            while (a + d <= n && !((!usado[a] || a == perm[pos - 1]) && (!usado[a + d] || a + d == perm[pos - 1]))) a++;
+            if (a + d > n) {
+                estadisticas.cortes_anticipacion[pos]++;
+                return;
+            }
+        }
+    }
+
+    // Bucle que intenta colocar cada número del 1 al n en la permutación.
+    estadisticas.expandidos[pos]++;
+    unsigned long long hijos = estadisticas.nodos[pos + 1];
+    for (int num = 1; num <= n; num++) {
+        
+        // Verifica si el número ya ha sido utilizado en la permutación actual.
+        if (usado[num]) estadisticas.rechazo_usado[pos]++;
+        if (!usado[num]) {  
+
+            // Si no es el primer número, verificar restricciones de diferencias.
+            if (pos > 0) {  // Ya se han colocado al menos dos números en la permutación.
+                int diff = abs(num - perm[pos - 1]);  // Calcula la diferencia absoluta con el número anterior.
+                
+                // Si la diferencia ya se ha usado o es inválida, descartar esta opción (poda).
+                // La diferencia no va a ser cero, n puede ser mayor o igual a n o ya fue usada.
+                if (diff < 1 || diff >= n || diferencias[diff]) {
+                    if (diferencias[diff]) estadisticas.rechazo_dif[pos]++;
+                    else estadisticas.rechazo_fuera[pos]++;
+                    continue; // Se salta esta iteración del bucle y prueba otro número.
+                }
+                
+                // Marca la diferencia como utilizada en esta rama de la recursión.
+                diferencias[diff] = true;  
+            }
+            
+            // Asigna el número a la posición actual en la permutación.
+            perm[pos] = num;
+            usado[num] = true;  // Marca el número como utilizado.
+
+            // Llamado recursivo para llenar la siguiente posición.
+            backtrack(perm, usado, diferencias, n, pos + 1);
+            
+            // Si se agotó el tiempo en la recursión, terminar la búsqueda.
+            if (tiempo_agotado) return;
+
+            // *** RETROCESO (Backtracking) ***
+            // Se deshacen los cambios y se regresa a la llamada anterior de la recursión para probar una nueva opción.
+            // Deshacer cambios para explorar otra posible solución.
+            usado[num] = false;  // Marca el número como disponible nuevamente.
+            
+            // Si se usó una diferencia, se desmarca para permitir nuevas combinaciones.
+            if (pos > 0) {
+                diferencias[abs(num - perm[pos - 1])] = false;
+            }
+        }
+    }
+    if (estadisticas.nodos[pos + 1] == hijos) estadisticas.sin_salida[pos]++;
+}
+
+
+// Motor de máscaras de bits
+/*Como n <= 50, todo el estado cabe en tres palabras de 64 bits:
+- libres: bit v en 1 si el número v (1..n) todavía no se ha usado.
+- difs: bit d en 1 si la diferencia d (1..n-1) todavía no se ha usado.
+- difs_inv: la misma información que difs pero reflejada (bit 63-d), para poder desplazar hacia abajo.
+Los siguientes valores legales para perm[pos] son los números libres a una distancia libre de
+perm[pos-1], es decir (difs << ultimo) | (difs_inv >> (63 - ultimo)) filtrado con libres.
+Como las máscaras se pasan por valor, el retroceso no tiene que deshacer nada.*/
+
+// Tarea: prefijo de una permutación cuyo subárbol completo hay que contar.
+typedef struct {
+    int n;  // Tamaño de la permutación (con --range conviven tareas de varios n)
+    int len;  // Cantidad de valores fijados
+    signed char valores[MAX_N];  // perm[0..len-1]
+} tarea_t;
+
+// Cola doble de tareas de un hilo.
+/*El dueño saca del fondo (la tarea más reciente, que suele ser la más pequeña) y los demás hilos
+roban del frente (las más antiguas, que suelen ser las más grandes). Las tareas son gruesas,
+así que basta con un mutex por cola.*/
+typedef struct {
+    pthread_mutex_t cerrojo;
+    tarea_t *tareas;
+    int inicio, fin, capacidad;  // Las tareas ocupan [inicio, fin)
+} cola_t;
+
+// Tabla de transposición (--memo)
+/*Muchos prefijos distintos llegan al mismo estado (libres, difs, último valor), y el subárbol de un
+estado no depende del camino. Cada hilo tiene su propia tabla, de tamaño fijo, con cubetas de
+MEMO_VIAS entradas: la primera guarda el subárbol más grande visto (más posiciones libres) y la
+segunda se reemplaza siempre. La clave se guarda completa, así que no hay falsos aciertos.
+Solo se guardan subárboles recorridos enteros: ni los interrumpidos ni los que cedieron trabajo.*/
+typedef struct {
+    uint64_t clave;  // libres | ultimo << 56 (0: entrada vacía)
+    uint64_t difs;  // difs | n << 56: con --range la misma tabla sirve para todos los n
+    unsigned long long cuenta;  // Soluciones del subárbol, sin el peso de simetría del prefijo
+} entrada_memo_t;
+
+typedef struct {
+    entrada_memo_t *entradas;  // num_cubetas * MEMO_VIAS entradas
+    uint64_t num_cubetas;  // Potencia de 2 (0: sin tabla)
+    unsigned long long consultas, aciertos, guardados;
+} memo_t;
+
+// Salida binaria de las soluciones (--emit)
+/*Cada hilo escribe sus permutaciones en su propio buffer alineado de SALIDA_BUFFER bytes, que se
+vacía en un archivo temporal del hilo; al final el hilo principal los concatena en el archivo
+pedido. Así los hilos nunca comparten nada mientras buscan. Formato (little-endian):
+    cabecera de 64 bytes:
+        0  "GRACEMIT"            8  uint32 versión (1)      12 uint32 n
+        16 uint32 bits por valor 20 uint32 banderas (bit 0: delta, bit 1: búsqueda incompleta)
+        24 uint64 soluciones     32 uint64 registros por bloque (como máximo)
+        40 uint64 bloques        48 uint64 desplazamiento del índice   56 uint64 reservado
+    bloques de registros, cada uno alineado a un byte y escrito por un solo hilo;
+    índice: por bloque, uint64 desplazamiento y uint64 número del primer registro.
+Cada valor se guarda como v-1 en 'bits' bits, empaquetados desde el bit menos significativo.
+Sin delta, un registro son n valores. Con delta (--emit_delta), el primero de cada bloque es
+completo y los demás empiezan con la longitud del prefijo que comparten con el anterior (en 'bits'
+bits) seguida solo de los valores que cambian; como cada hilo recorre su árbol en orden, los
+vecinos comparten prefijos largos. Con --simetria no: cada solución se escribe con su órbita
+(c(p), r(p), rc(p)), que casi no comparte prefijo con ella, así que el prefijo de cada registro
+cuesta 'bits' bits de más y el archivo crece (n=14: 7.46 contra 7.01 bytes por registro). Por eso
+--emit_delta se desactiva con --simetria; ordenar cada bloque recuperaría el prefijo pero perdería
+el orden de búsqueda de los registros. Para llegar al registro i se busca en el índice el bloque que lo
+contiene y se decodifica desde su comienzo (leer_soluciones.py lo hace). Los registros quedan en el
+orden en que los encontró cada hilo, no en orden lexicográfico global.*/
+typedef struct {
+    uint64_t desplazamiento;  // Dentro del archivo (dentro del temporal del hilo mientras se busca)
+    uint64_t primero;  // Número del primer registro del bloque
+} bloque_salida_t;
+
+typedef struct {
+    uint8_t *buffer;  // SALIDA_BUFFER bytes alineados a una página
+    size_t usados;  // Bytes llenos del buffer
+    uint64_t acumulador;  // Bits que todavía no completan un byte
+    int bits_acumulados;
+    FILE *temporal;  // Donde se vacía el buffer
+    unsigned long long vaciados;  // Bytes ya escritos en el temporal
+    unsigned long long registros;  // Permutaciones escritas por el hilo
+    int en_bloque;  // Registros en el bloque en curso
+    int anterior[MAX_N];  // Último registro escrito (para el modo delta)
+    bloque_salida_t *bloques;
+    long long num_bloques, capacidad_bloques;
+} salida_t;
+
+// Fila de la tabla de --range: lo que costó contar un n.
+/*Con el motor de bits los hilos mezclan tareas de varios n, así que el tiempo de cada fila es la
+suma del tiempo que los hilos pasaron en tareas de ese n (con un hilo coincide con el de pared).*/
+typedef struct {
+    unsigned long long soluciones, nodos;
+    long long tiempo_us;
+    bool incompleto;  // Quedaron tareas de este n sin terminar (se agotó el tiempo)
+} fila_rango_t;
+
+// Estado de un hilo de búsqueda.
+/*Los candidatos que faltan por explorar en cada nivel se guardan en pendientes[] y no en variables
+locales: así el hilo puede ceder a otros hilos los hermanos pendientes de su búsqueda en curso.
+El contador de soluciones es propio de cada hilo y solo se suma al final.*/
+typedef struct {
+    _Alignas(64) int id;
+    int n;
+    int base;  // Longitud del prefijo de la tarea en curso (esos niveles no se pueden ceder)
+    int pos_corte;  // Con --simetria, desde esta posición la diferencia n-1 ya debe estar usada
+    uint64_t difs_grandes;  // Diferencias que revisa la poda por anticipación (bits d >= umbral)
+    uint64_t niveles_grados;  // Bit pos en 1 si en esa profundidad se aplica la poda por grados
+    uint64_t niveles_perf;  // Bit pos en 1 si pos es el borde de una banda de --perf
+    int perm[MAX_N + 1];  // Permutación parcial
+    uint64_t pendientes[MAX_N + 1];  // Candidatos aún no explorados en cada posición
+    unsigned long long soluciones;  // Permutaciones gráciles encontradas por este hilo
+    estadisticas_t est;  // Contadores por profundidad de este hilo (solo nodos, expandidos, sin salida y cortes)
+    atomic_ullong nodos_publicados;  // Copias que el coordinador lee para el progreso, se actualizan
+    atomic_ullong soluciones_publicadas;  // en cada revisión del reloj
+    presupuesto_t presupuesto;
+    unsigned int semilla;  // Para elegir a quién robar
+    unsigned long long cesiones;  // Veces que este hilo cedió trabajo (invalida los subárboles en curso para la tabla)
+    memo_t memo;
+    unsigned long long subarboles_hojas;  // Subárboles resueltos con la tabla del núcleo de hojas
+    double nodos_omitidos_hojas;  // Nodos que esos subárboles habrían visitado (estimación por muestreo)
+    double nodos_ahorrados_grados;  // Lo mismo para los cortes de la poda por grados
+    contadores_t perf;  // Contadores del procesador de este hilo (--perf)
+    double perf_total[EVENTOS_PERF];  // Todo lo que contó el hilo, desde que arrancó hasta que terminó
+    signed char banda_en[MAX_N + 2];  // Banda de --perf de cada profundidad
+    salida_t salida;  // Buffer propio de --emit
+    fila_rango_t filas[MAX_N + 1];  // Lo que este hilo contó de cada n con --range
+    pthread_t hilo;
+    _Alignas(64) cola_t cola;  // En otra línea de caché: la tocan los demás hilos
+} trabajador_t;
+
+trabajador_t *trabajadores;  // Arreglo de 'hilos' trabajadores
+atomic_llong tareas_pendientes;  // Tareas creadas que todavía no se han terminado
+atomic_int solicitudes_division;  // Hilos ociosos que esperan que alguien ceda trabajo
+memo_t memo_total;  // Contadores sumados de las tablas de todos los hilos
+
+// Contadores de --perf sumados de todos los hilos
+contadores_t perf_principal;  // Los del hilo principal: miden los motores de un hilo y el reparto del de bits
+bool perf_disponible[EVENTOS_PERF];  // Eventos que se pudieron abrir en esta máquina
+double perf_total[EVENTOS_PERF];
+unsigned long long perf_muestras[BANDAS_PERF + 1][EVENTOS_PERF];
+
+// Interrupción de la búsqueda
+/*'interrumpir' es la única bandera que se mira en el camino caliente: se activa cuando se agota el
+tiempo o cuando el coordinador pide una pausa para escribir un checkpoint. Al verla, cada hilo
+deja en su cola la parte de su búsqueda que no alcanzó a recorrer (ver volcar_frontera), de modo
+que las colas siempre describen exactamente lo que falta contar.*/
+atomic_bool interrumpir;
+bool pausa = false;  // Protegida por cerrojo_pausa
+int hilos_en_pausa = 0;  // Hilos detenidos esperando a que termine la pausa
+int hilos_terminados = 0;  // Hilos que ya salieron de su ciclo
+pthread_mutex_t cerrojo_pausa = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cambio_pausa = PTHREAD_COND_INITIALIZER;  // Avisa a los hilos que la pausa terminó
+pthread_cond_t cambio_hilos;  // Avisa al coordinador que un hilo se detuvo o terminó (plazos en CLOCK_MONOTONIC)
+
+// Función que devuelve la posición del bit menos significativo en 1 (x no puede ser 0).
+static inline int ctz64(uint64_t x) {
+    return __builtin_ctzll(x);
+}
+
+// Máscaras iniciales: todos los números 1..n y todas las diferencias 1..n-1 libres.
+static inline uint64_t mascara_valores(int n) { return ((1ULL << n) - 1) << 1; }
+static inline uint64_t mascara_difs(int n) { return ((1ULL << (n - 1)) - 1) << 1; }
+static inline uint64_t mascara_difs_inv(int n) { return ((1ULL << (n - 1)) - 1) << (64 - n); }
+
+// Números libres a una diferencia libre de 'ultimo'.
+static inline uint64_t candidatos_de(uint64_t libres, uint64_t difs, uint64_t difs_inv, int ultimo) {
+    return ((difs << ultimo) | (difs_inv >> (63 - ultimo))) & libres;
+}
+
+// Poda por grados (--grados k)
+/*En la permutación final cada valor libre queda entre dos vecinos, salvo el que termine el camino,
+que tiene uno. Sus vecinos solo pueden ser otros libres o el último colocado (los demás valores
+usados ya tienen sus dos lados ocupados), y cada uno a una diferencia libre distinta. Para todos los
+valores a la vez: por cada diferencia libre d, los que tienen un posible vecino a distancia d son
+(disponibles << d) | (disponibles >> d); 'uno' y 'dos' acumulan los que tienen al menos uno y al
+menos dos. Si algún libre no tiene ninguno, o más de uno tiene menos de dos, no hay camino.
+Es más fuerte que la falta de candidatos (que solo mira al último valor) y descubre antes los
+valores que se quedaron aislados. Cuesta un desplazamiento por diferencia libre, por eso se aplica
+solo cada k niveles.*/
+static inline bool falta_grado(uint64_t libres, uint64_t difs, int ultimo) {
+    uint64_t disponibles = libres | (1ULL << ultimo), uno = 0, dos = 0;
+    for (; difs; difs &= difs - 1) {
+        int d = ctz64(difs);
+        uint64_t vecinos = (disponibles << d) | (disponibles >> d);
+        dos |= uno & vecinos;
+        uno |= vecinos;
+    }
+    uint64_t flojos = libres & ~dos;  // Libres con a lo sumo un vecino posible: solo puede haber uno
+    return (libres & ~uno) != 0 || (flojos & (flojos - 1)) != 0;
+}
+
+// Operaciones de la cola doble
+void cola_iniciar(cola_t *c) {
+    pthread_mutex_init(&c->cerrojo, NULL);
+    c->capacidad = 64;
+    c->tareas = malloc(c->capacidad * sizeof(tarea_t));
+    c->inicio = c->fin = 0;
+}
+
+void cola_liberar(cola_t *c) {
+    pthread_mutex_destroy(&c->cerrojo);
+    free(c->tareas);
+}
+
+void cola_meter(cola_t *c, const tarea_t *t) {
+    pthread_mutex_lock(&c->cerrojo);
+    if (c->fin == c->capacidad) {
+        // Se compacta hacia el inicio y, si sigue llena, se duplica la capacidad.
+        int ocupadas = c->fin - c->inicio;
+        memmove(c->tareas, c->tareas + c->inicio, ocupadas * sizeof(tarea_t));
+        c->inicio = 0;
+        c->fin = ocupadas;
+        if (ocupadas == c->capacidad) {
+            c->capacidad *= 2;
+            c->tareas = realloc(c->tareas, c->capacidad * sizeof(tarea_t));
+        }
+    }
+    c->tareas[c->fin++] = *t;
+    pthread_mutex_unlock(&c->cerrojo);
+}
+
+// Saca la tarea del fondo (uso del dueño de la cola).
+bool cola_sacar_fondo(cola_t *c, tarea_t *t) {
+    bool hay = false;
+    pthread_mutex_lock(&c->cerrojo);
+    if (c->fin > c->inicio) {
+        *t = c->tareas[--c->fin];
+        hay = true;
+    }
+    pthread_mutex_unlock(&c->cerrojo);
+    return hay;
+}
+
+// Saca la tarea del frente (uso de los ladrones).
+bool cola_sacar_frente(cola_t *c, tarea_t *t) {
+    bool hay = false;
+    pthread_mutex_lock(&c->cerrojo);
+    if (c->fin > c->inicio) {
+        *t = c->tareas[c->inicio++];
+        hay = true;
+    }
+    pthread_mutex_unlock(&c->cerrojo);
+    return hay;
+}
+
+// Crea una tarea a partir de perm[0..len-1] seguido de 'num' y la deja en la cola del trabajador.
+void publicar_tarea(trabajador_t *w, const int perm[], int len, int num) {
+    tarea_t t;
+    t.n = w->n;
+    t.len = len + 1;
+    for (int i = 0; i < len; i++) t.valores[i] = (signed char)perm[i];
+    t.valores[len] = (signed char)num;
+    atomic_fetch_add(&tareas_pendientes, 1);  // Antes de publicarla, para que nadie vea el contador en 0
+    cola_meter(&w->cola, &t);
+}
+
+// Cede a los hilos ociosos todos los hermanos pendientes del nivel más superficial que los tenga.
+/*Se cede el nivel más cercano a la raíz porque ahí están los subárboles abiertos más grandes:
+una sola cesión alcanza para mantener ocupado al hilo que la pidió por bastante tiempo.*/
+void ceder_trabajo(trabajador_t *w, int pos) {
+    for (int nivel = w->base; nivel < pos; nivel++) {
+        uint64_t c = w->pendientes[nivel];
+        if (c == 0) continue;
+        w->pendientes[nivel] = 0;
+        w->cesiones++;
+        while (c) {
+            publicar_tarea(w, w->perm, nivel, ctz64(c));
+            c &= c - 1;
+        }
+        return;
+    }
+}
+
+// Reducción por simetría (--simetria)
+/*Si p es grácil también lo son su inversión r(p), su complemento c(p) (x -> n+1-x) y rc(p).
+El complemento conserva la sucesión de diferencias y la inversión la invierte, así que si i es el
+índice de la diferencia n-1 (la del par {1, n}) en p, en r(p) está en n-2-i. Se cuentan solo las p con:
+- i <= m = (n-2)/2: la diferencia n-1 en la primera mitad. Se poda en cuanto se pasa de la mitad
+  sin haberla usado, lo que deja cerca de la mitad de los nodos profundos.
+- p[0] < (n+1)/2, o p[0] = (n+1)/2 y p[1] < (n+1)/2: c es una involución sin puntos fijos que
+  conserva i, así que parte cada conjunto en dos mitades iguales; se aplica en la raíz.
+Si i < (n-2)/2, la permutación representa a 4 (ella, r, c y rc son distintas en índice o en p[0]).
+Si n es par e i = (n-2)/2, r conserva i y la permutación representa solo a 2 (ella y c(p)); su
+inversión aparece por separado como otro representante.*/
+unsigned long long peso_simetria(const int perm[], int n) {
+    for (int i = 0; i + 1 < n; i++) {
+        if (abs(perm[i + 1] - perm[i]) == n - 1) return (n % 2 == 0 && i == (n - 2) / 2) ? 2 : 4;
+    }
+    return 4;  // n == 1 no llega aquí
+}
+
+// Bits por valor en --emit: alcanzan para 0..n-1.
+int bits_salida(int n) {
+    int bits = 1;
+    while ((1 << bits) < n) bits++;
+    return bits;
+}
+
+void salida_iniciar(salida_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->buffer = aligned_alloc(4096, SALIDA_BUFFER);
+    s->temporal = tmpfile();
+    if (s->buffer == NULL || s->temporal == NULL) {
+        printf("No se pudo preparar la salida de --emit.\n");
+        exit(1);
+    }
+}
+
+void salida_vaciar(salida_t *s) {
+    if (s->usados > 0 && fwrite(s->buffer, 1, s->usados, s->temporal) != s->usados) {
+        printf("No se pudo escribir la salida de --emit.\n");
+        exit(1);
+    }
+    s->vaciados += s->usados;
+    s->usados = 0;
+}
+
+static inline void salida_bits(salida_t *s, uint64_t valor, int bits) {
+    s->acumulador |= valor << s->bits_acumulados;
+    s->bits_acumulados += bits;
+    while (s->bits_acumulados >= 8) {
+        if (s->usados == SALIDA_BUFFER) salida_vaciar(s);
+        s->buffer[s->usados++] = (uint8_t)s->acumulador;
+        s->acumulador >>= 8;
+        s->bits_acumulados -= 8;
+    }
+}
+
+// Completa el último byte del bloque en curso con ceros.
+void salida_cerrar_bloque(salida_t *s) {
+    if (s->bits_acumulados > 0) salida_bits(s, 0, 8 - s->bits_acumulados);
+    s->en_bloque = 0;
+}
+
+void salida_registro(salida_t *s, const int perm[], int n) {
+    int bits = bits_salida(n);
+    if (s->en_bloque == SALIDA_POR_BLOQUE) salida_cerrar_bloque(s);
+    if (s->en_bloque == 0) {
+        if (s->num_bloques == s->capacidad_bloques) {
+            s->capacidad_bloques = s->capacidad_bloques ? 2 * s->capacidad_bloques : 64;
+            s->bloques = realloc(s->bloques, s->capacidad_bloques * sizeof(bloque_salida_t));
+        }
+        s->bloques[s->num_bloques].desplazamiento = s->vaciados + s->usados;
+        s->bloques[s->num_bloques].primero = s->registros;
+        s->num_bloques++;
+    }
+    int comun = 0;
+    if (salida_delta && s->en_bloque > 0) {
+        while (comun < n - 1 && perm[comun] == s->anterior[comun]) comun++;
+        salida_bits(s, comun, bits);
+    }
+    for (int i = comun; i < n; i++) {
+        salida_bits(s, perm[i] - 1, bits);
+        s->anterior[i] = perm[i];
+    }
+    s->en_bloque++;
+    s->registros++;
+}
+
+// Escribe una solución encontrada; con --simetria, todas las de su órbita (ver peso_simetria).
+void emitir_solucion(salida_t *s, const int perm[], int n) {
+    salida_registro(s, perm, n);
+    if (!simetria) return;
+    int otra[MAX_N] = {0};  // Inicializado solo para que gcc no avise (el bucle siempre llena n valores)
+    for (int i = 0; i < n; i++) otra[i] = n + 1 - perm[i];  // c(p)
+    salida_registro(s, otra, n);
+    if (peso_simetria(perm, n) == 2) return;
+    for (int i = 0; i < n; i++) otra[i] = perm[n - 1 - i];  // r(p)
+    salida_registro(s, otra, n);
+    for (int i = 0; i < n; i++) otra[i] = n + 1 - perm[n - 1 - i];  // rc(p)
+    salida_registro(s, otra, n);
+}
+
+static void escribir_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void escribir_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+// Junta las salidas de los hilos en archivo_emit, con la cabecera y el índice. Libera las salidas.
+bool escribir_emit(int n, salida_t salidas[], int num_salidas) {
+    FILE *f = fopen(archivo_emit, "wb");
+    if (f == NULL) return false;
+    uint8_t cabecera[SALIDA_CABECERA] = {0};
+    bool ok = fwrite(cabecera, 1, SALIDA_CABECERA, f) == SALIDA_CABECERA;  // Se reescribe al final
+
+    unsigned long long desplazamiento = SALIDA_CABECERA, registros = 0;
+    long long bloques = 0;
+    for (int i = 0; i < num_salidas; i++) {
+        salida_t *s = &salidas[i];
+        salida_cerrar_bloque(s);
+        salida_vaciar(s);
+        rewind(s->temporal);
+        size_t leidos;
+        while (ok && (leidos = fread(s->buffer, 1, SALIDA_BUFFER, s->temporal)) > 0)
+            ok = fwrite(s->buffer, 1, leidos, f) == leidos;
+        for (long long b = 0; b < s->num_bloques; b++) {
+            s->bloques[b].desplazamiento += desplazamiento;
+            s->bloques[b].primero += registros;
+        }
+        desplazamiento += s->vaciados;
+        registros += s->registros;
+        bloques += s->num_bloques;
+    }
+    for (int i = 0; i < num_salidas; i++) {
+        for (long long b = 0; ok && b < salidas[i].num_bloques; b++) {
+            uint8_t entrada[16];
+            escribir_u64(entrada, salidas[i].bloques[b].desplazamiento);
+            escribir_u64(entrada + 8, salidas[i].bloques[b].primero);
+            ok = fwrite(entrada, 1, sizeof(entrada), f) == sizeof(entrada);
+        }
+        fclose(salidas[i].temporal);
+        free(salidas[i].buffer);
+        free(salidas[i].bloques);
+    }
+
+    memcpy(cabecera, "GRACEMIT", 8);
+    escribir_u32(cabecera + 8, 1);
+    escribir_u32(cabecera + 12, n);
+    escribir_u32(cabecera + 16, bits_salida(n));
+    escribir_u32(cabecera + 20, (salida_delta ? 1 : 0) | (tiempo_agotado ? 2 : 0));
+    escribir_u64(cabecera + 24, registros);
+    escribir_u64(cabecera + 32, SALIDA_POR_BLOQUE);
+    escribir_u64(cabecera + 40, bloques);
+    escribir_u64(cabecera + 48, desplazamiento);
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(cabecera, 1, SALIDA_CABECERA, f) == SALIDA_CABECERA;
+    ok = (fclose(f) == 0) && ok;
+    registros_emitidos = registros;
+    bytes_emitidos = desplazamiento + bloques * 16;
+    return ok;
+}
+
+// Deja como tareas el nodo actual (si todavía no se expandió) y todos los hermanos pendientes de la
+// búsqueda en curso. Lo que queda en las colas más lo ya contado cubre el árbol completo.
+// 'pos' es el último nivel cuyos pendientes se vuelcan; con nodo_actual, el nodo es perm[0..pos]
+// (se entró a él desde el nivel pos) y se publica entero, no su padre.
+void volcar_frontera(trabajador_t *w, int pos, bool nodo_actual) {
+    if (nodo_actual) publicar_tarea(w, w->perm, pos, w->perm[pos]);
+    for (int nivel = w->base; nivel <= pos; nivel++) {
+        uint64_t c = w->pendientes[nivel];
+        w->pendientes[nivel] = 0;
+        while (c) {
+            publicar_tarea(w, w->perm, nivel, ctz64(c));
+            c &= c - 1;
+        }
+    }
+}
+
+// Reserva la tabla de transposición de un trabajador con a lo sumo 'bytes' bytes.
+void memo_iniciar(memo_t *m, long long bytes) {
+    uint64_t cubetas = 1;
+    while ((long long)(cubetas * 2 * MEMO_VIAS * sizeof(entrada_memo_t)) <= bytes) cubetas *= 2;
+    m->entradas = calloc(cubetas * MEMO_VIAS, sizeof(entrada_memo_t));
+    m->num_cubetas = m->entradas ? cubetas : 0;
+}
+
+// Primera entrada de la cubeta que le corresponde a un estado.
+static inline entrada_memo_t *memo_cubeta(memo_t *m, uint64_t clave, uint64_t difs) {
+    uint64_t h = clave * 0x9E3779B97F4A7C15ULL ^ difs * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    return &m->entradas[(h & (m->num_cubetas - 1)) * MEMO_VIAS];
+}
+
+// Busca un estado en la tabla. Devuelve true y su cuenta si está.
+static inline bool memo_buscar(memo_t *m, uint64_t clave, uint64_t difs, unsigned long long *cuenta) {
+    entrada_memo_t *e = memo_cubeta(m, clave, difs);
+    m->consultas++;
+    for (int k = 0; k < MEMO_VIAS; k++) {
+        if (e[k].clave == clave && e[k].difs == difs) {
+            m->aciertos++;
+            *cuenta = e[k].cuenta;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Guarda un estado: en la primera entrada si su subárbol es al menos tan grande como el que
+// está ahí (que pasa a la segunda), si no en la segunda.
+void memo_guardar(memo_t *m, uint64_t clave, uint64_t difs, unsigned long long cuenta) {
+    entrada_memo_t *e = memo_cubeta(m, clave, difs);
+    entrada_memo_t nueva = {clave, difs, cuenta};
+    int libres_nueva = __builtin_popcountll(clave & ((1ULL << 56) - 1));
+    int libres_primera = __builtin_popcountll(e[0].clave & ((1ULL << 56) - 1));
+    if (e[0].clave == 0 || libres_nueva >= libres_primera) {
+        if (e[0].clave != clave || e[0].difs != difs) e[1] = e[0];
+        e[0] = nueva;
+    } else {
+        e[1] = nueva;
+    }
+    m->guardados++;
+}
+
+// Nodos visitados por un trabajador (suma de todas las profundidades).
+unsigned long long nodos_de(const estadisticas_t *e) {
+    unsigned long long total = 0;
+    for (int d = 0; d <= MAX_N + 1; d++) total += e->nodos[d];
+    return total;
+}
+
+// Deja a la vista del coordinador los contadores del trabajador.
+void contar_cola(int n, int perm[], uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos,
+                 uint64_t difs_grandes, int pos_corte, double *nodos, double *soluciones);
+
+void publicar_contadores(trabajador_t *w) {
+    atomic_store_explicit(&w->nodos_publicados, nodos_de(&w->est), memory_order_relaxed);
+    atomic_store_explicit(&w->soluciones_publicadas, w->soluciones, memory_order_relaxed);
+}
+
+// Núcleo de hojas (--hojas k)
+/*Casi todos los nodos están en los últimos niveles. Cuando quedan k valores libres, las formas de
+terminar dependen solo del último valor u, de los libres R y de las diferencias libres D (que son
+exactamente k). Al empezar se recorren todos los órdenes de cada R posible desde cada u, y los que
+usan k diferencias distintas se cuentan en una tabla hash indexada por (R ∪ {u}, u, D); así el
+subárbol entero se resuelve con una consulta. Las diferencias no cambian al trasladar todos los
+valores, así que la clave se normaliza restando el menor de R ∪ {u}: la tabla no depende de dónde
+está el bloque dentro de 1..n y es unas n veces más chica.
+Las podas que la consulta se salta solo eliminan ramas sin soluciones, así que la cuenta no cambia.
+Para informar cuántos nodos se dejaron de visitar, uno de cada HOJAS_MUESTREO subárboles se
+recorre también con contar_cola y se extrapola.*/
+typedef struct {
+    entrada_memo_t *entradas;  // clave = valores normalizados | u << 56; cuenta = órdenes válidos
+    uint64_t capacidad;  // Potencia de 2 (se duplica al pasar del 70 %)
+    uint64_t ocupadas;
+    int k;  // Valores libres cuando se consulta (0: sin núcleo)
+    long long tiempo_us;  // Lo que tardó en llenarse
+} tabla_hojas_t;
+
+tabla_hojas_t tabla_hojas;
+unsigned long long subarboles_hojas = 0;  // Consultas hechas por todos los hilos
+double nodos_omitidos_hojas = 0;  // Estimación de los nodos que no se visitaron gracias a la tabla
+
+static inline uint64_t hojas_indice(uint64_t clave, uint64_t difs) {
+    uint64_t h = clave * 0x9E3779B97F4A7C15ULL ^ difs * 0xC2B2AE3D27D4EB4FULL;
+    return (h ^ (h >> 31)) & (tabla_hojas.capacidad - 1);
+}
+
+// Formas de terminar desde el estado normalizado (clave, difs); 0 si no está en la tabla.
+static inline unsigned long long hojas_buscar(uint64_t clave, uint64_t difs) {
+    for (uint64_t i = hojas_indice(clave, difs); tabla_hojas.entradas[i].clave != 0; i = (i + 1) & (tabla_hojas.capacidad - 1)) {
+        if (tabla_hojas.entradas[i].clave == clave && tabla_hojas.entradas[i].difs == difs)
+            return tabla_hojas.entradas[i].cuenta;
+    }
+    return 0;
+}
+
+void hojas_sumar(uint64_t clave, uint64_t difs, unsigned long long cuenta) {
+    if (10 * (tabla_hojas.ocupadas + 1) > 7 * tabla_hojas.capacidad) {
+        entrada_memo_t *viejas = tabla_hojas.entradas;
+        uint64_t capacidad_vieja = tabla_hojas.capacidad;
+        tabla_hojas.capacidad = capacidad_vieja ? 2 * capacidad_vieja : 1024;
+        tabla_hojas.entradas = calloc(tabla_hojas.capacidad, sizeof(entrada_memo_t));
+        if (tabla_hojas.entradas == NULL) {
+            printf("No hay memoria para la tabla del nucleo de hojas.\n");
+            exit(1);
+        }
+        tabla_hojas.ocupadas = 0;
+        for (uint64_t i = 0; i < capacidad_vieja; i++) {
+            if (viejas[i].clave != 0) hojas_sumar(viejas[i].clave, viejas[i].difs, viejas[i].cuenta);
+        }
+        free(viejas);
+    }
+    uint64_t i = hojas_indice(clave, difs);
+    while (tabla_hojas.entradas[i].clave != 0 && (tabla_hojas.entradas[i].clave != clave || tabla_hojas.entradas[i].difs != difs))
+        i = (i + 1) & (tabla_hojas.capacidad - 1);
+    if (tabla_hojas.entradas[i].clave == 0) {
+        tabla_hojas.entradas[i].clave = clave;
+        tabla_hojas.entradas[i].difs = difs;
+        tabla_hojas.ocupadas++;
+    }
+    tabla_hojas.entradas[i].cuenta += cuenta;
+}
+
+// Recorre los órdenes de 'quedan' que empiezan después de 'ultimo' con diferencias distintas.
+void ordenar_hojas(uint64_t valores, int u, int ultimo, uint64_t quedan, uint64_t difs) {
+    if (quedan == 0) {
+        hojas_sumar(valores | (uint64_t)u << 56, difs, 1);
+        return;
+    }
+    for (uint64_t c = quedan; c; c &= c - 1) {
+        int v = ctz64(c);
+        uint64_t bit = 1ULL << abs(v - ultimo);
+        if (!(difs & bit)) ordenar_hojas(valores, u, v, quedan & ~(1ULL << v), difs | bit);
+    }
+}
+
+// Elige los k valores (además del 0, que es el menor tras normalizar) entre 1..n-1, desde 'desde'.
+void elegir_hojas(int n, int faltan, int desde, uint64_t valores) {
+    if (faltan == 0) {
+        for (uint64_t c = valores; c; c &= c - 1) {
+            int u = ctz64(c);
+            ordenar_hojas(valores, u, u, valores & ~(1ULL << u), 0);
+        }
+        return;
+    }
+    for (int v = desde; v <= n - faltan; v++) elegir_hojas(n, faltan - 1, v + 1, valores | (1ULL << v));
+}
+
+// Llena la tabla para n y k (k se baja si la tabla costaría demasiado de construir).
+void hojas_iniciar(int n, int k) {
+    long long inicio = reloj_us();
+    if (k > n - 2) k = n - 2;  // Al menos dos valores antes de la consulta
+    while (k >= 2) {
+        double ordenes = factorial(k + 1);  // (k+1)! órdenes por cada conjunto de k+1 valores
+        for (int i = 0; i < k; i++) ordenes = ordenes * (n - 1 - i) / (i + 1);
+        if (ordenes <= HOJAS_ORDENES_MAX) break;
+        k--;
+    }
+    if (k < 2) return;
+    tabla_hojas.k = k;
+    elegir_hojas(n, k, 1, 1);
+    tabla_hojas.tiempo_us = reloj_us() - inicio;
+}
+
+// Resuelve con la tabla el subárbol de un nodo al que le quedan tabla_hojas.k valores libres.
+__attribute__((noinline))
+void resolver_hojas(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    int u = w->perm[pos - 1];
+    uint64_t valores = libres | (1ULL << u);
+    int menor = ctz64(valores);
+    unsigned long long cuenta = hojas_buscar((valores >> menor) | (uint64_t)(u - menor) << 56, difs);
+    unsigned long long peso = simetria ? peso_simetria(w->perm, w->n) : 1;  // La diferencia n-1 ya está usada
+    w->soluciones += cuenta * peso;
+    if (++w->subarboles_hojas % HOJAS_MUESTREO == 0) {
+        double nodos = 0, soluciones = 0;
+        contar_cola(w->n, w->perm, libres, difs, difs_inv, pos, w->difs_grandes, w->pos_corte, &nodos, &soluciones);
+        w->nodos_omitidos_hojas += nodos * HOJAS_MUESTREO;
+    }
+}
+
+// Anota un corte de la poda por grados; uno de cada GRADOS_MUESTREO se recorre para estimar lo ahorrado.
+__attribute__((noinline))
+void cortar_por_grados(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    if (++w->est.cortes_grados[pos] % GRADOS_MUESTREO == 0) {
+        double nodos = 0, soluciones = 0;
+        contar_cola(w->n, w->perm, libres, difs, difs_inv, pos, w->difs_grandes, w->pos_corte, &nodos, &soluciones);
+        w->nodos_ahorrados_grados += nodos * GRADOS_MUESTREO;
+    }
+}
+
+void backtrack_bits(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos);
+void entrar_banda(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos);
+
+// Expande un nodo: recorre solo los candidatos válidos, del menor al mayor.
+static inline void expandir_bits(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    int ultimo = w->perm[pos - 1];
+    w->pendientes[pos] = candidatos_de(libres, difs, difs_inv, ultimo);
+    w->est.expandidos[pos]++;
+    if (w->pendientes[pos] == 0) w->est.sin_salida[pos]++;
+
+    while (w->pendientes[pos]) {
+        uint64_t c = w->pendientes[pos];
+        int num = ctz64(c);
+        w->pendientes[pos] = c & (c - 1);  // Quita el bit menos significativo
+
+        int diff = abs(num - ultimo);
+        w->perm[pos] = num;
+        backtrack_bits(w, libres & ~(1ULL << num), difs & ~(1ULL << diff),
+                       difs_inv & ~(1ULL << (63 - diff)), pos + 1);
+        // Si hubo una interrupción, el hijo ya dejó su frontera y los hermanos pendientes
+        // de este nivel (y de los superiores) se vuelcan al desenrollar.
+        if (interrumpir) {
+            volcar_frontera(w, pos, false);
+            return;
+        }
+    }
+}
+
+// Expande un nodo pasando por la tabla de transposición.
+/*Con --simetria, si la diferencia n-1 ya está en el prefijo todas las hojas del subárbol tienen el
+mismo peso, que se saca de la cuenta guardada; si no, el peso de cada hoja depende solo de pos,
+que está determinada por libres. Va aparte de backtrack_bits para no cargar su camino caliente.*/
+__attribute__((noinline))
+void expandir_memo(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    uint64_t clave = libres | (uint64_t)w->perm[pos - 1] << 56, firma = difs | (uint64_t)w->n << 56;
+    unsigned long long peso = 1, cuenta;
+    if (simetria && !(difs & (1ULL << (w->n - 1)))) peso = peso_simetria(w->perm, w->n);
+    if (memo_buscar(&w->memo, clave, firma, &cuenta)) {
+        w->soluciones += cuenta * peso;
+        return;
+    }
+
+    unsigned long long soluciones_antes = w->soluciones, cesiones_antes = w->cesiones;
+    expandir_bits(w, libres, difs, difs_inv, pos);
+    if (!interrumpir && w->cesiones == cesiones_antes)
+        memo_guardar(&w->memo, clave, firma, (w->soluciones - soluciones_antes) / peso);
+}
+
+// Versión del backtracking con máscaras de bits ejecutada por un trabajador.
+void backtrack_bits(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    // Con --perf, los nodos en el borde de una banda se recorren dentro de entrar_banda.
+    if ((w->niveles_perf >> pos) & 1) {
+        entrar_banda(w, libres, difs, difs_inv, pos);
+        return;
+    }
+
+    // El reloj (y las peticiones de otros hilos) solo se revisan cuando se termina el presupuesto.
+    if (--w->presupuesto.nodos_restantes == 0) {
+        revisar_tiempo(&w->presupuesto);
+        if (tiempo_agotado) atomic_store(&interrumpir, true);
+        if (interrumpir) {
+            // El nodo actual aún no se ha expandido: se guarda completo junto con sus hermanos pendientes.
+            volcar_frontera(w, pos - 1, true);
+            return;
+        }
+        if (atomic_load_explicit(&solicitudes_division, memory_order_relaxed) > 0) ceder_trabajo(w, pos);
+        publicar_contadores(w);
+    }
+    w->est.nodos[pos]++;  // Después de la revisión: un nodo volcado como tarea se cuenta cuando se ejecute
+
+    // Representantes canónicos: la diferencia n-1 tiene que aparecer en la primera mitad.
+    if (pos >= w->pos_corte && (difs & (1ULL << (w->n - 1)))) {
+        w->est.cortes_simetria[pos]++;
+        return;
+    }
+
+    // Caso base: permutación completa.
+    if (pos == w->n) {
+        w->soluciones += simetria ? peso_simetria(w->perm, w->n) : 1;
+        if (archivo_emit != NULL) emitir_solucion(&w->salida, w->perm, w->n);
+        return;
+    }
+
+    // Poda por anticipación: cada diferencia grande sin usar necesita un par {a, a+d} en el que ambos
+    // valores puedan quedar vecinos más adelante, es decir, libres o el último colocado (que aún tiene
+    // un lado libre). Las diferencias grandes tienen pocos pares (n-1 solo {1, n}), así que son las
+    // primeras en quedarse sin ninguno; con disponibles en bits, cada d se revisa con un desplazamiento.
+    uint64_t grandes = difs & w->difs_grandes;
+    if (grandes) {
+        uint64_t disponibles = libres | (1ULL << w->perm[pos - 1]);
+        do {
+            int d = ctz64(grandes);
+            if ((disponibles & (disponibles >> d)) == 0) {
+                w->est.cortes_anticipacion[pos]++;
+                return;
+            }
+            grandes &= grandes - 1;
+        } while (grandes);
+    }
+
+    if ((w->niveles_grados >> pos) & 1 && falta_grado(libres, difs, w->perm[pos - 1])) {
+        cortar_por_grados(w, libres, difs, difs_inv, pos);
+        return;
+    }
+
+    // Con --simetria la consulta solo vale si la diferencia n-1 ya está usada (si no, el corte de
+    // simetría todavía podría descartar hojas); si falta, se sigue recursivamente.
+    if (w->n - pos == tabla_hojas.k && (!simetria || !(difs & (1ULL << (w->n - 1))))) {
+        resolver_hojas(w, libres, difs, difs_inv, pos);
+        return;
+    }
+
+    if (w->memo.num_cubetas && pos >= MEMO_POS_MIN && w->n - pos >= MEMO_RESTANTES_MIN)
+        expandir_memo(w, libres, difs, difs_inv, pos);
+    else
+        expandir_bits(w, libres, difs, difs_inv, pos);
+}
+
+// Núcleos especializados por n (--nucleo fijo)
+/*backtrack_bits recibe n en tiempo de ejecución, así que el compilador no conoce el ancho de las
+máscaras ni los límites de los bucles. DEFINIR_NUCLEO genera una copia del mismo recorrido para
+cada n de NUCLEOS_32 y NUCLEOS_64 con n constante: la comparación con la hoja, el bit de la
+diferencia n-1 y el reflejo de difs_inv quedan como constantes, y para n <= 31 las máscaras son de
+32 bits (valores 1..n y difs_inv con la diferencia d en el bit 31-d). La revisión de las diferencias
+grandes sigue siendo el bucle con ctz: desenrollarla entera y sin saltos (d = 1..n-1) resultó un
+25 % más lenta a n=16, porque hace siempre n-1 pruebas y el bucle solo recorre las diferencias
+grandes que siguen libres. Los núcleos no tienen la tabla de transposición ni el núcleo de hojas:
+con --memo o --hojas se usa siempre backtrack_bits.
+ejecutar_tarea elige el núcleo en la tabla 'nucleos' según el n de cada tarea.*/
+#define NUCLEOS_32(X) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) X(16) X(17) \
+    X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+#define NUCLEOS_64(X) X(32) X(33) X(34) X(35) X(36) X(37) X(38) X(39) X(40)
+
+#define DEFINIR_NUCLEO(N, T)                                                                              \
+static void nucleo_##N(trabajador_t *w, T libres, T difs, T difs_inv, int pos) {                          \
+    enum { ANCHO = 8 * sizeof(T) };                                                                       \
+    if ((w->niveles_perf >> pos) & 1) {                                                                   \
+        entrar_banda(w, libres, difs, (uint64_t)difs_inv << (64 - ANCHO), pos);                           \
+        return;                                                                                           \
+    }                                                                                                     \
+    if (--w->presupuesto.nodos_restantes == 0) {                                                          \
+        revisar_tiempo(&w->presupuesto);                                                                  \
+        if (tiempo_agotado) atomic_store(&interrumpir, true);                                             \
+        if (interrumpir) {                                                                                \
+            volcar_frontera(w, pos - 1, true);                                                            \
+            return;                                                                                       \
+        }                                                                                                 \
+        if (atomic_load_explicit(&solicitudes_division, memory_order_relaxed) > 0) ceder_trabajo(w, pos); \
+        publicar_contadores(w);                                                                           \
+    }                                                                                                     \
+    w->est.nodos[pos]++;                                                                                  \
+    if (pos >= w->pos_corte && (difs & ((T)1 << (N - 1)))) {                                              \
+        w->est.cortes_simetria[pos]++;                                                                    \
+        return;                                                                                           \
+    }                                                                                                     \
+    if (pos == N) {                                                                                       \
+        w->soluciones += simetria ? peso_simetria(w->perm, N) : 1;                                        \
+        if (archivo_emit != NULL) emitir_solucion(&w->salida, w->perm, N);                                \
+        return;                                                                                           \
+    }                                                                                                     \
+    int ultimo = w->perm[pos - 1];                                                                        \
+    T grandes = difs & (T)w->difs_grandes, disponibles = libres | ((T)1 << ultimo);                       \
+    for (; grandes; grandes &= grandes - 1) {                                                             \
+        if ((disponibles & (disponibles >> ctz64(grandes))) == 0) {                                       \
+            w->est.cortes_anticipacion[pos]++;                                                            \
+            return;                                                                                       \
+        }                                                                                                 \
+    }                                                                                                     \
+    if ((w->niveles_grados >> pos) & 1 && falta_grado(libres, difs, ultimo)) {                            \
+        cortar_por_grados(w, libres, difs, (uint64_t)difs_inv << (64 - ANCHO), pos);                      \
+        return;                                                                                           \
+    }                                                                                                     \
+    w->pendientes[pos] = ((difs << ultimo) | (difs_inv >> (ANCHO - 1 - ultimo))) & libres;                \
+    w->est.expandidos[pos]++;                                                                             \
+    if (w->pendientes[pos] == 0) w->est.sin_salida[pos]++;                                                \
+    while (w->pendientes[pos]) {                                                                          \
+        uint64_t c = w->pendientes[pos];                                                                  \
+        int num = ctz64(c);                                                                               \
+        w->pendientes[pos] = c & (c - 1);                                                                 \
+        int diff = abs(num - ultimo);                                                                     \
+        w->perm[pos] = num;                                                                               \
+        nucleo_##N(w, libres & ~((T)1 << num), difs & ~((T)1 << diff),                                    \
+                   difs_inv & ~((T)1 << (ANCHO - 1 - diff)), pos + 1);                                    \
+        if (interrumpir) {                                                                                \
+            volcar_frontera(w, pos, false);                                                               \
+            return;                                                                                       \
+        }                                                                                                 \
+    }                                                                                                     \
+}                                                                                                         \
+static void entrar_##N(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {     \
+    nucleo_##N(w, (T)libres, (T)difs, (T)(difs_inv >> (64 - 8 * sizeof(T))), pos);                       \
+}
+
+#define DEFINIR_NUCLEO_32(N) DEFINIR_NUCLEO(N, uint32_t)
+#define DEFINIR_NUCLEO_64(N) DEFINIR_NUCLEO(N, uint64_t)
+NUCLEOS_32(DEFINIR_NUCLEO_32)
+NUCLEOS_64(DEFINIR_NUCLEO_64)
+
+typedef void (*nucleo_t)(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos);
+#define ENTRADA_NUCLEO(N) [N] = entrar_##N,
+const nucleo_t nucleos[MAX_N + 1] = {NUCLEOS_32(ENTRADA_NUCLEO) NUCLEOS_64(ENTRADA_NUCLEO)};
+
+// Paso por el borde de una banda (--perf)
+/*El árbol, desde la profundidad de las tareas hasta n, se parte en BANDAS_PERF bandas. Al entrar en
+un nodo del borde se anota la nueva banda para el manejador de la señal, se recorre el subárbol y al
+volver se deja la banda de antes. El bit del borde se apaga mientras tanto para que el mismo nodo no
+vuelva a entrar aquí. Entre dos bordes no se toca nada: la banda solo cambia al cruzarlos.*/
+__attribute__((noinline))
+void entrar_banda(trabajador_t *w, uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos) {
+    int anterior = w->perf.banda;
+    w->perf.banda = w->banda_en[pos];
+    w->niveles_perf &= ~(1ULL << pos);
+    if (nucleo_fijo && nucleos[w->n] != NULL) nucleos[w->n](w, libres, difs, difs_inv, pos);
+    else backtrack_bits(w, libres, difs, difs_inv, pos);
+    w->niveles_perf |= 1ULL << pos;
+    w->perf.banda = anterior;
+}
+
+// Profundidad de los prefijos iniciales para un n.
+int profundidad_para(int n) {
+    int profundidad = profundidad_division;
+    if (profundidad < 1) profundidad = 1;
+    if (profundidad > n) profundidad = n;
+    // Con --simetria hacen falta al menos dos posiciones para aplicar el corte del complemento en la raíz.
+    if (simetria && profundidad < 2) profundidad = 2;
+    return profundidad;
+}
+
+// Borde superior de la banda b de --perf para un n: las bandas parten en partes iguales los niveles
+// que recorren las tareas (desde la profundidad de los prefijos hasta n).
+int borde_perf(int n, int b) {
+    int inicio = profundidad_para(n);
+    return inicio + b * (n - inicio) / BANDAS_PERF;
+}
+
+// Menor diferencia que revisa la poda por anticipación para un n, según lo pedido con --anticipar
+// (-1: n/2, 0: ninguna). Un umbral ya resuelto para ese n queda igual.
+int resolver_umbral(int pedido, int n) {
+    if (pedido < 0) pedido = n / 2;  // El mejor umbral medido para n = 15..17
+    if (pedido == 0 || pedido > n) pedido = n;  // Sin diferencias que revisar
+    return pedido;
+}
+
+// Deja al trabajador listo para tareas de tamaño n.
+void preparar_trabajador(trabajador_t *w, int n) {
+    w->n = n;
+    w->pos_corte = simetria ? (n - 2) / 2 + 2 : n + 1;
+    w->difs_grandes = mascara_difs(n) & ~((1ULL << resolver_umbral(umbral_anticipacion, n)) - 1);
+    w->niveles_grados = 0;
+    for (int pos = poda_grados; poda_grados > 0 && pos < n; pos += poda_grados) w->niveles_grados |= 1ULL << pos;
+    w->niveles_perf = 0;
+    for (int d = 0; d <= n + 1; d++) w->banda_en[d] = 0;
+    for (int b = 0; medir_perf && b < BANDAS_PERF; b++) {
+        w->niveles_perf |= 1ULL << borde_perf(n, b);
+        for (int d = borde_perf(n, b); d <= n + 1; d++) w->banda_en[d] = b + 1;
+    }
+}
+
+// Cuenta el subárbol completo de una tarea.
+void ejecutar_tarea(trabajador_t *w, const tarea_t *t) {
+    if (t->n != w->n) preparar_trabajador(w, t->n);  // Solo pasa con --range
+    int n = w->n;
+    uint64_t libres = mascara_valores(n), difs = mascara_difs(n), difs_inv = mascara_difs_inv(n);
+
+    // Reconstruye las máscaras a partir del prefijo (ya validado cuando se creó la tarea).
+    for (int i = 0; i < t->len; i++) {
+        int num = t->valores[i];
+        w->perm[i] = num;
+        libres &= ~(1ULL << num);
+        if (i > 0) {
+            int diff = abs(num - t->valores[i - 1]);
+            difs &= ~(1ULL << diff);
+            difs_inv &= ~(1ULL << (63 - diff));
+        }
+    }
+    w->base = t->len;
+    w->perf.banda = w->banda_en[t->len];  // Las tareas cedidas empiezan más abajo que los prefijos
+    if (nucleo_fijo && nucleos[n] != NULL) nucleos[n](w, libres, difs, difs_inv, t->len);
+    else backtrack_bits(w, libres, difs, difs_inv, t->len);
+    w->perf.banda = 0;
+}
+
+// Ejecuta una tarea de --range y anota en la fila de su n lo que costó.
+void ejecutar_en_rango(trabajador_t *w, const tarea_t *t) {
+    fila_rango_t *f = &w->filas[t->n];
+    unsigned long long soluciones = w->soluciones, nodos = nodos_de(&w->est);
+    long long inicio = reloj_us();
+    ejecutar_tarea(w, t);
+    f->tiempo_us += reloj_us() - inicio;
+    f->soluciones += w->soluciones - soluciones;
+    f->nodos += nodos_de(&w->est) - nodos;
+}
+
+// Intenta robar una tarea de la cola de otro hilo, empezando por uno al azar.
+bool robar_tarea(trabajador_t *w, tarea_t *t) {
+    // Generador xorshift de 32 bits: basta para repartir los robos y no depende de rand_r.
+    w->semilla ^= w->semilla << 13;
+    w->semilla ^= w->semilla >> 17;
+    w->semilla ^= w->semilla << 5;
+    int inicio = w->semilla % hilos;
+    for (int k = 0; k < hilos; k++) {
+        int victima = (inicio + k) % hilos;
+        if (victima != w->id && cola_sacar_frente(&trabajadores[victima].cola, t)) return true;
+    }
+    return false;
+}
+
+// Detiene al hilo mientras dure la pausa pedida por el coordinador.
+void esperar_pausa(void) {
+    pthread_mutex_lock(&cerrojo_pausa);
+    hilos_en_pausa++;
+    pthread_cond_signal(&cambio_hilos);
+    while (pausa) pthread_cond_wait(&cambio_pausa, &cerrojo_pausa);
+    hilos_en_pausa--;
+    pthread_mutex_unlock(&cerrojo_pausa);
+}
+
+// Ciclo de cada hilo: tomar tareas propias o robadas hasta que no quede ninguna o se acabe el tiempo.
+void *ciclo_trabajador(void *arg) {
+    trabajador_t *w = arg;
+    tarea_t t;
+    bool pidio = false;  // Si este hilo está anotado en solicitudes_division
+    double perf_inicio[EVENTOS_PERF], perf_fin[EVENTOS_PERF];
+
+    // Los contadores cuentan solo al hilo que los abre, así que cada trabajador abre los suyos.
+    if (medir_perf) {
+        perf_abrir(&w->perf);
+        perf_leer(&w->perf, perf_inicio);
+    }
+    iniciar_presupuesto(&w->presupuesto);
+    while (!tiempo_agotado) {
+        if (interrumpir) {
+            esperar_pausa();
+            continue;
+        }
+        if (cola_sacar_fondo(&w->cola, &t) || robar_tarea(w, &t)) {
+            if (pidio) {
+                atomic_fetch_sub(&solicitudes_division, 1);
+                pidio = false;
+            }
+            // Una tarea interrumpida ya dejó en la cola lo que le faltaba, así que cuenta como terminada.
+            if (rango_hasta > 0) ejecutar_en_rango(w, &t);
+            else ejecutar_tarea(w, &t);
+            atomic_fetch_sub(&tareas_pendientes, 1);
+        } else {
+            // Nada que hacer: si tampoco hay tareas en curso en otros hilos, terminó la búsqueda.
+            if (atomic_load(&tareas_pendientes) == 0) break;
+            if (!pidio) {
+                atomic_fetch_add(&solicitudes_division, 1);
+                pidio = true;
+            }
+            sched_yield();
+        }
+    }
+    if (pidio) atomic_fetch_sub(&solicitudes_division, 1);
+    publicar_contadores(w);
+    if (medir_perf) {
+        perf_leer(&w->perf, perf_fin);
+        perf_acumular(perf_inicio, perf_fin, w->perf_total);
+        perf_cerrar(&w->perf);
+    }
+
+    pthread_mutex_lock(&cerrojo_pausa);
+    hilos_terminados++;
+    pthread_cond_signal(&cambio_hilos);
+    pthread_mutex_unlock(&cerrojo_pausa);
+    return NULL;
+}
+
+// Genera en orden lexicográfico todos los prefijos válidos de longitud 'profundidad' y los
+// reparte por turnos entre las colas de los trabajadores.
+void generar_prefijos(int n, int profundidad, int perm[], uint64_t libres, uint64_t difs,
+                      uint64_t difs_inv, int pos, int *siguiente) {
+    if (simetria && pos >= (n - 2) / 2 + 2 && (difs & (1ULL << (n - 1)))) {  // Mismo corte que backtrack_bits
+        estadisticas.cortes_simetria[pos]++;
+        return;
+    }
+    if (pos == profundidad) {
+        if (prefijos_totales++ % num_shards == shard) {
+            publicar_tarea(&trabajadores[*siguiente], perm, pos - 1, perm[pos - 1]);
+            *siguiente = (*siguiente + 1) % hilos;
+            prefijos_propios++;
+        }
+        return;
+    }
+    uint64_t candidatos = (pos == 0) ? libres : candidatos_de(libres, difs, difs_inv, perm[pos - 1]);
+    estadisticas.nodos[pos]++;  // Los nodos de longitud 'profundidad' los cuentan los hilos
+    nodos_visitados++;
+    if (pos > 0) {  // Misma poda por anticipación que backtrack_bits
+        uint64_t disponibles = libres | (1ULL << perm[pos - 1]);
+        for (uint64_t grandes = difs & trabajadores[0].difs_grandes; grandes; grandes &= grandes - 1) {
+            if ((disponibles & (disponibles >> ctz64(grandes))) == 0) {
+                estadisticas.cortes_anticipacion[pos]++;
+                return;
+            }
+        }
+    }
+    estadisticas.expandidos[pos]++;
+    if (candidatos == 0) estadisticas.sin_salida[pos]++;
+    if (simetria) {
+        // Mitad canónica bajo el complemento: p[0] <= (n+1)/2 y, si p[0] es el centro, p[1] por debajo de él.
+        int centro2 = n + 1;  // Dos veces el centro (n+1)/2, para no usar fracciones
+        if (pos == 0) candidatos &= (1ULL << (centro2 / 2 + 1)) - 1;
+        if (pos == 1 && 2 * perm[0] == centro2) candidatos &= (1ULL << (centro2 / 2)) - 1;
+    }
+    while (candidatos) {
+        int num = ctz64(candidatos);
+        candidatos &= candidatos - 1;
+        int diff = (pos == 0) ? 0 : abs(num - perm[pos - 1]);
+        perm[pos] = num;
+        generar_prefijos(n, profundidad, perm, libres & ~(1ULL << num), difs & ~(1ULL << diff),
+                         difs_inv & ~(1ULL << (63 - diff)), pos + 1, siguiente);
+    }
+}
+
+// Checkpoints
+/*Formato de texto, una línea por dato:
+    GRACILES-CHECKPOINT 1
+    n <n>
+    simetria <0|1>
+    shard <i> <N> <prefijos propios> <prefijos totales> <profundidad>
+    soluciones <permutaciones contadas en los subárboles ya terminados>
+    nodos <nodos visitados hasta ahora>
+    tiempo_us <tiempo acumulado de todas las ejecuciones>
+    tareas <cantidad de prefijos pendientes>
+    <len> <v1> ... <vlen>     (una línea por prefijo pendiente)
+El archivo se escribe primero en <archivo>.tmp y luego se renombra, para que un corte a mitad
+de la escritura no deje un checkpoint dañado.*/
+bool escribir_checkpoint(const char *archivo, int n, unsigned long long soluciones,
+                         unsigned long long nodos, long long tiempo_us) {
+    char temporal[1024];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", archivo);
+    FILE *f = fopen(temporal, "w");
+    if (f == NULL) return false;
+
+    long long total = 0;
+    for (int i = 0; i < hilos; i++) total += trabajadores[i].cola.fin - trabajadores[i].cola.inicio;
+
+    fprintf(f, "%s\nn %d\nsimetria %d\nshard %d %d %lld %lld %d\nsoluciones %llu\nnodos %llu\ntiempo_us %lld\ntareas %lld\n",
+            CABECERA_CHECKPOINT, n, simetria ? 1 : 0, shard, num_shards, prefijos_propios, prefijos_totales,
+            profundidad_division, soluciones, nodos, tiempo_us, total);
+    for (int i = 0; i < hilos; i++) {
+        cola_t *c = &trabajadores[i].cola;
+        for (int k = c->inicio; k < c->fin; k++) {
+            fprintf(f, "%d", c->tareas[k].len);
+            for (int j = 0; j < c->tareas[k].len; j++) fprintf(f, " %d", c->tareas[k].valores[j]);
+            fputc('\n', f);
+        }
+    }
+    bool ok = (fclose(f) == 0);
+    if (ok) ok = (rename(temporal, archivo) == 0);
+    tareas_en_frontera = total;
+    return ok;
+}
+
+// Lee un checkpoint y reparte sus prefijos pendientes entre las colas.
+// Devuelve las soluciones y los nodos ya contados.
+bool leer_checkpoint(const char *archivo, int n, unsigned long long *soluciones, unsigned long long *nodos) {
+    FILE *f = fopen(archivo, "r");
+    if (f == NULL) {
+        printf("No se pudo abrir el checkpoint %s.\n", archivo);
+        return false;
+    }
+    char cabecera[64];
+    int n_archivo, simetria_archivo, shard_archivo, num_shards_archivo;
+    long long tareas;
+    bool ok = fgets(cabecera, sizeof(cabecera), f) != NULL
+           && strncmp(cabecera, CABECERA_CHECKPOINT, strlen(CABECERA_CHECKPOINT)) == 0
+           && fscanf(f, " n %d simetria %d shard %d %d %lld %lld %d soluciones %llu nodos %llu tiempo_us %lld tareas %lld",
+                     &n_archivo, &simetria_archivo, &shard_archivo, &num_shards_archivo, &prefijos_propios,
+                     &prefijos_totales, &profundidad_division, soluciones, nodos, &tiempo_previo_us, &tareas) == 11;
+    if (!ok) {
+        printf("El archivo %s no es un checkpoint valido.\n", archivo);
+    } else if (n_archivo != n || simetria_archivo != (simetria ? 1 : 0)
+               || shard_archivo != shard || num_shards_archivo != num_shards) {
+        printf("El checkpoint es de n=%d%s, shard %d/%d; no corresponde a esta ejecucion.\n",
+               n_archivo, simetria_archivo ? " con --simetria" : "", shard_archivo, num_shards_archivo);
+        ok = false;
+    }
+    for (long long k = 0; ok && k < tareas; k++) {
+        tarea_t t;
+        int len, v;
+        ok = fscanf(f, "%d", &len) == 1 && len >= 1 && len <= n;
+        for (int j = 0; ok && j < len; j++) {
+            ok = fscanf(f, "%d", &v) == 1 && v >= 1 && v <= n;
+            t.valores[j] = (signed char)v;
+        }
+        if (!ok) {
+            printf("Checkpoint %s truncado.\n", archivo);
+            break;
+        }
+        t.n = n;
+        t.len = len;
+        atomic_fetch_add(&tareas_pendientes, 1);
+        cola_meter(&trabajadores[k % hilos].cola, &t);
+    }
+    fclose(f);
+    return ok;
+}
+
+// Espera a que todos los hilos terminen y, mientras tanto, escribe el progreso y los checkpoints periódicos.
+/*Para escribir un checkpoint el coordinador activa 'interrumpir': cada hilo vuelca su frontera a su
+cola y se detiene. Con todos detenidos, las colas y los contadores describen la búsqueda de forma
+exacta; se escribe el archivo y los hilos siguen desde las colas. El progreso no necesita pausa:
+se arma con los contadores que cada hilo publica en su revisión del reloj.*/
+void coordinar(int n) {
+    const long long nunca = 1LL << 62;
+    long long proximo_checkpoint = archivo_checkpoint ? reloj_us() + intervalo_checkpoint_us : nunca;
+    long long proximo_progreso = intervalo_progreso_us ? reloj_us() + intervalo_progreso_us : nunca;
+
+    pthread_mutex_lock(&cerrojo_pausa);
+    while (hilos_terminados < hilos) {
+        long long proximo = proximo_checkpoint < proximo_progreso ? proximo_checkpoint : proximo_progreso;
+        if (proximo == nunca) {
+            pthread_cond_wait(&cambio_hilos, &cerrojo_pausa);
+            continue;
+        }
+
+        long long ahora = reloj_us();
+        if (ahora < proximo) {
+            // Espera con plazo: hasta el próximo evento o hasta que algún hilo avise. El plazo va en
+            // el mismo reloj monotónico que reloj_us, así un ajuste de la hora no lo adelanta ni atrasa.
+            struct timespec plazo;
+            clock_gettime(CLOCK_MONOTONIC, &plazo);
+            long long ns = plazo.tv_nsec + (proximo - ahora) * 1000LL;
+            plazo.tv_sec += ns / 1000000000LL;
+            plazo.tv_nsec = ns % 1000000000LL;
+            pthread_cond_timedwait(&cambio_hilos, &cerrojo_pausa, &plazo);
+            continue;
+        }
+
+        if (ahora >= proximo_progreso) {
+            unsigned long long nodos = nodos_visitados, soluciones = contador;
+            for (int i = 0; i < hilos; i++) {
+                nodos += atomic_load_explicit(&trabajadores[i].nodos_publicados, memory_order_relaxed);
+                soluciones += atomic_load_explicit(&trabajadores[i].soluciones_publicadas, memory_order_relaxed);
+            }
+            emitir_progreso(nodos, soluciones, atomic_load(&tareas_pendientes));
+            proximo_progreso = ahora + intervalo_progreso_us;
+        }
+        if (ahora < proximo_checkpoint) continue;
+
+        // Pausa: esperar a que todos los hilos se detengan o terminen.
+        pausa = true;
+        atomic_store(&interrumpir, true);
+        while (hilos_en_pausa + hilos_terminados < hilos) pthread_cond_wait(&cambio_hilos, &cerrojo_pausa);
+
+        unsigned long long soluciones = contador, nodos = nodos_visitados;
+        for (int i = 0; i < hilos; i++) {
+            soluciones += trabajadores[i].soluciones;
+            nodos += nodos_de(&trabajadores[i].est);
+        }
+        if (!escribir_checkpoint(archivo_checkpoint, n, soluciones, nodos, tiempo_previo_us + reloj_us() - comienzo))
+            fprintf(stderr, "No se pudo escribir el checkpoint %s.\n", archivo_checkpoint);
+
+        pausa = false;
+        if (!tiempo_agotado) atomic_store(&interrumpir, false);
+        pthread_cond_broadcast(&cambio_pausa);
+        proximo_checkpoint = reloj_us() + intervalo_checkpoint_us;
+    }
+    pthread_mutex_unlock(&cerrojo_pausa);
+}
+
+// Rechazos equivalentes a los del bucle 1..n del motor clásico (ver estadisticas_t), para los motores
+// que solo recorren candidatos válidos.
+void deducir_rechazos(int n) {
+    for (int d = 1; d < n; d++) {
+        estadisticas.rechazo_usado[d] = d * estadisticas.expandidos[d];
+        estadisticas.rechazo_dif[d] = (n - d) * estadisticas.expandidos[d] - estadisticas.nodos[d + 1];
+    }
+}
+
+// Crea los trabajadores del motor de bits con sus colas y buffers, listos para tareas de tamaño n.
+void crear_trabajadores(int n) {
+    trabajadores = calloc(hilos, sizeof(trabajador_t));
+    atomic_store(&tareas_pendientes, 0);
+    atomic_store(&solicitudes_division, 0);
+    atomic_store(&interrumpir, false);
+    hilos_en_pausa = hilos_terminados = 0;
+    for (int i = 0; i < hilos; i++) {
+        trabajadores[i].id = i;
+        preparar_trabajador(&trabajadores[i], n);
+        trabajadores[i].semilla = 12345u + i;
+        cola_iniciar(&trabajadores[i].cola);
+        if (memo_bytes > 0) memo_iniciar(&trabajadores[i].memo, memo_bytes / hilos);
+        if (archivo_emit != NULL) salida_iniciar(&trabajadores[i].salida);
+    }
+}
+
+// Lanza un hilo por trabajador y espera a que se vacíen las colas; el hilo principal coordina.
+void correr_trabajadores(int n) {
+    for (int i = 0; i < hilos; i++) pthread_create(&trabajadores[i].hilo, NULL, ciclo_trabajador, &trabajadores[i]);
+    coordinar(n);
+    for (int i = 0; i < hilos; i++) pthread_join(trabajadores[i].hilo, NULL);
+}
+
+// Suma los contadores de cada hilo a los globales.
+void sumar_trabajadores(void) {
+    for (int i = 0; i < hilos; i++) {
+        trabajador_t *w = &trabajadores[i];
+        contador += w->soluciones;
+        nodos_visitados += nodos_de(&w->est);
+        for (int d = 0; d <= MAX_N + 1; d++) {
+            estadisticas.nodos[d] += w->est.nodos[d];
+            estadisticas.expandidos[d] += w->est.expandidos[d];
+            estadisticas.sin_salida[d] += w->est.sin_salida[d];
+            estadisticas.cortes_simetria[d] += w->est.cortes_simetria[d];
+            estadisticas.cortes_anticipacion[d] += w->est.cortes_anticipacion[d];
+            estadisticas.cortes_grados[d] += w->est.cortes_grados[d];
+        }
+        for (int e = 0; e < EVENTOS_PERF; e++) {
+            perf_total[e] += w->perf_total[e];
+            for (int b = 0; b <= BANDAS_PERF; b++) perf_muestras[b][e] += w->perf.muestras[b][e];
+        }
+        memo_total.num_cubetas += w->memo.num_cubetas;
+        memo_total.consultas += w->memo.consultas;
+        memo_total.aciertos += w->memo.aciertos;
+        memo_total.guardados += w->memo.guardados;
+        subarboles_hojas += w->subarboles_hojas;
+        nodos_omitidos_hojas += w->nodos_omitidos_hojas;
+        nodos_ahorrados_grados += w->nodos_ahorrados_grados;
+    }
+}
+
+void liberar_trabajadores(void) {
+    for (int i = 0; i < hilos; i++) {
+        cola_liberar(&trabajadores[i].cola);
+        free(trabajadores[i].memo.entradas);
+    }
+    free(trabajadores);
+}
+
+// Conteo con el motor de máscaras de bits (n >= 2), repartido entre 'hilos' hilos.
+unsigned long long contar_bits(int n) {
+    int perm[MAX_N + 1];
+    int siguiente = 0;
+
+    crear_trabajadores(n);
+    if (hojas_k > 0) hojas_iniciar(n, hojas_k);
+
+    // 'contador' y 'nodos_visitados' guardan lo que ya venía contado en el checkpoint; los hilos suman aparte.
+    contador = 0;
+    nodos_visitados = 0;
+    if (archivo_reanudar != NULL) {
+        if (!leer_checkpoint(archivo_reanudar, n, &contador, &nodos_visitados)) exit(1);
+    } else {
+        // La diferencia 0 nunca se usa, así que quitarla de las máscaras en la primera posición no afecta.
+        profundidad_division = profundidad_para(n);  // Se anota la profundidad efectiva en checkpoints y shards
+        prefijos_totales = prefijos_propios = 0;
+        generar_prefijos(n, profundidad_division, perm, mascara_valores(n), mascara_difs(n), mascara_difs_inv(n), 0,
+                         &siguiente);
+        // Todos los shards recorren los mismos nodos de prefijo: solo el 0 los suma a sus nodos, así
+        // fusionar_shards.py da el total de una ejecución sin --shard. Los niveles los siguen mostrando
+        // (sin ellos los rechazos deducidos del nivel de corte saldrían negativos).
+        if (shard > 0) nodos_visitados = 0;
+    }
+
+    correr_trabajadores(n);
+    sumar_trabajadores();
+    deducir_rechazos(n);
+    if (archivo_emit != NULL) {
+        salida_t *salidas = malloc(hilos * sizeof(salida_t));
+        for (int i = 0; i < hilos; i++) salidas[i] = trabajadores[i].salida;
+        if (!escribir_emit(n, salidas, hilos)) printf("No se pudo escribir %s.\n", archivo_emit);
+        free(salidas);
+    }
+
+    // Checkpoint final: si se agotó el tiempo contiene la frontera exacta; si no, queda sin tareas.
+    if (archivo_checkpoint != NULL
+        && !escribir_checkpoint(archivo_checkpoint, n, contador, nodos_visitados, tiempo_previo_us + reloj_us() - comienzo))
+        fprintf(stderr, "No se pudo escribir el checkpoint %s.\n", archivo_checkpoint);
+
+    liberar_trabajadores();
+    return contador;
+}
+
+// Barrido de --range con el motor de bits: todos los n en una sola búsqueda.
+/*Los hilos, sus colas y sus tablas se crean una vez. Los prefijos de todos los n se reparten antes
+de arrancar, del n más chico al más grande: cada hilo saca del fondo de su cola, así que empieza
+por los n grandes, y al final los que se quedan sin trabajo roban del frente los subárboles de los
+n chicos, que son los que mejor rellenan. Como las tareas llevan su n, no hay una espera entre un
+n y el siguiente.*/
+void contar_rango_bits(int desde, int hasta, fila_rango_t filas[]) {
+    int perm[MAX_N + 1];
+    crear_trabajadores(hasta);
+    contador = 0;
+    nodos_visitados = 0;
+    prefijos_totales = prefijos_propios = 0;
+    for (int n = desde; n <= hasta; n++) {
+        if (n < 2) {
+            filas[n].soluciones = 1;  // Como en contar_permutaciones_graciles
+            continue;
+        }
+        int siguiente = 0;
+        unsigned long long nodos = nodos_visitados;
+        long long inicio = reloj_us();
+        for (int i = 0; i < hilos; i++) preparar_trabajador(&trabajadores[i], n);  // generar_prefijos usa su n
+        generar_prefijos(n, profundidad_para(n), perm, mascara_valores(n), mascara_difs(n), mascara_difs_inv(n), 0,
+                         &siguiente);
+        filas[n].nodos += nodos_visitados - nodos;
+        filas[n].tiempo_us += reloj_us() - inicio;
+    }
+
+    correr_trabajadores(hasta);
+    for (int i = 0; i < hilos; i++) {
+        trabajador_t *w = &trabajadores[i];
+        for (int n = desde; n <= hasta; n++) {
+            filas[n].soluciones += w->filas[n].soluciones;
+            filas[n].nodos += w->filas[n].nodos;
+            filas[n].tiempo_us += w->filas[n].tiempo_us;
+        }
+        for (int k = w->cola.inicio; k < w->cola.fin; k++) filas[w->cola.tareas[k].n].incompleto = true;
+    }
+    liberar_trabajadores();
+}
+
+// Checkpoints del motor iterativo
+/*Todo el estado de la búsqueda está en gp_iter_t, así que en vez de una frontera de prefijos se
+guarda el iterador tal cual (gp_iter_save) detrás de lo que él no sabe:
+    GRACILES-CHECKPOINT-ITER 1
+    soluciones <permutaciones ya entregadas>
+    tiempo_us <tiempo acumulado de todas las ejecuciones>
+    <estado de gp_iter_save>
+Se escribe en <archivo>.tmp y se renombra, como el del motor de bits.*/
+bool escribir_checkpoint_iter(const char *archivo, const gp_iter_t *it, unsigned long long soluciones,
+                              long long tiempo_us) {
+    char temporal[1024];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", archivo);
+    FILE *f = fopen(temporal, "w");
+    if (f == NULL) return false;
+    fprintf(f, "%s\nsoluciones %llu\ntiempo_us %lld\n", CABECERA_CHECKPOINT_ITER, soluciones, tiempo_us);
+    bool ok = gp_iter_save(it, f);
+    ok = (fclose(f) == 0) && ok;
+    if (ok) ok = (rename(temporal, archivo) == 0);
+
+    // Subárboles pendientes: los candidatos que quedan sin explorar en cada nivel de la pila.
+    tareas_en_frontera = 0;
+    for (int k = 0; k <= it->pos; k++) tareas_en_frontera += __builtin_popcountll(it->candidatos[k]);
+    return ok;
+}
+
+// Carga un checkpoint del motor iterativo; el iterador tiene que ser del mismo n y umbral.
+bool leer_checkpoint_iter(const char *archivo, int n, gp_iter_t *it, unsigned long long *soluciones) {
+    FILE *f = fopen(archivo, "r");
+    if (f == NULL) {
+        printf("No se pudo abrir el checkpoint %s.\n", archivo);
+        return false;
+    }
+    char cabecera[64];
+    bool ok = fgets(cabecera, sizeof(cabecera), f) != NULL
+           && strncmp(cabecera, CABECERA_CHECKPOINT_ITER, strlen(CABECERA_CHECKPOINT_ITER)) == 0
+           && fscanf(f, " soluciones %llu tiempo_us %lld ", soluciones, &tiempo_previo_us) == 2
+           && gp_iter_load(it, f);
+    fclose(f);
+    if (!ok) {
+        printf("El archivo %s no es un checkpoint valido del motor iterativo.\n", archivo);
+        return false;
+    }
+    gp_iter_t nuevo;
+    gp_iter_init(&nuevo, n, umbral_anticipacion);  // Normaliza el umbral igual que al guardarlo
+    if (it->n != n || it->umbral != nuevo.umbral) {
+        printf("El checkpoint es de n=%d con umbral %d; no corresponde a esta ejecucion.\n", it->n, it->umbral);
+        return false;
+    }
+    return true;
+}
+
+// Conteo con el iterador de pila explícita (gp_iter.c). Entre dos soluciones el iterador vuelve cada
+// vez que se acaba el presupuesto de nodos, para revisar el reloj igual que los otros motores; en esa
+// misma pausa se escriben los checkpoints periódicos.
+unsigned long long contar_iterativo(int n) {
+    if (n < 1) return 1;  // La permutación vacía, como en el motor clásico
+    gp_iter_t *it = malloc(sizeof(gp_iter_t));
+    int perm[MAX_N];
+    int r;
+    contador = 0;
+    if (archivo_reanudar != NULL) {
+        if (!leer_checkpoint_iter(archivo_reanudar, n, it, &contador)) exit(1);
+    } else {
+        gp_iter_init(it, n, umbral_anticipacion);
+    }
+    long long proximo_checkpoint = reloj_us() + intervalo_checkpoint_us;
+    while ((r = gp_iter_next(it, perm, &presupuesto_global.nodos_restantes)) != GP_FIN) {
+        if (r == GP_SOLUCION) {
+            contador++;
+            if (listar) {
+                for (int i = 0; i < n; i++) printf(i ? " %d" : "%d", perm[i]);
+                putchar('\n');
+            }
+            continue;
+        }
+        revisar_tiempo(&presupuesto_global);
+        if (tiempo_agotado) break;
+        if (intervalo_progreso_us > 0 && presupuesto_global.ultima_revision - ultimo_progreso >= intervalo_progreso_us)
+            emitir_progreso(gp_iter_nodos(it), contador, -1);
+        if (archivo_checkpoint != NULL && presupuesto_global.ultima_revision >= proximo_checkpoint) {
+            if (!escribir_checkpoint_iter(archivo_checkpoint, it, contador, tiempo_previo_us + reloj_us() - comienzo))
+                fprintf(stderr, "No se pudo escribir el checkpoint %s.\n", archivo_checkpoint);
+            proximo_checkpoint = reloj_us() + intervalo_checkpoint_us;
+        }
+    }
+
+    // Checkpoint final: si se agotó el tiempo el iterador sigue desde ahí; si no, queda terminado.
+    if (archivo_checkpoint != NULL
+        && !escribir_checkpoint_iter(archivo_checkpoint, it, contador, tiempo_previo_us + reloj_us() - comienzo))
+        fprintf(stderr, "No se pudo escribir el checkpoint %s.\n", archivo_checkpoint);
+
+    nodos_visitados = gp_iter_nodos(it);
+    for (int d = 0; d <= n; d++) {
+        estadisticas.nodos[d] = it->nodos[d];
+        estadisticas.expandidos[d] = it->expandidos[d];
+        estadisticas.sin_salida[d] = it->sin_salida[d];
+        estadisticas.cortes_anticipacion[d] = it->cortes_anticipacion[d];
+    }
+    deducir_rechazos(n);
+    free(it);
+    return contador;
+}
+
+// Estimación del tamaño del árbol (--estimate)
+/*Estimador de Knuth: un sondeo baja de la raíz a una hoja eligiendo en cada nivel un hijo al azar
+entre los c candidatos. Si el camino pasa por niveles con c0, c1, ... hijos, 1 + c0 + c0*c1 + ...
+es una estimación sin sesgo del número de nodos, y el producto completo (por el peso de simetría)
+lo es del número de permutaciones si el sondeo llega a n. Se aplican las mismas podas que en
+backtrack_bits, así que la estimación es del árbol que de verdad se va a recorrer. Las soluciones
+son raras y casi ningún sondeo llega a una hoja, así que los últimos COLA_ESTIMACION niveles se
+cuentan completos (multiplicados por el producto acumulado): eso baja mucho la varianza de la
+estimación de soluciones. Aun así es grande, por eso se dan intervalos de confianza.*/
+
+// Cuenta exactamente el subárbol de un nodo al que ya se entró (con las podas de backtrack_bits).
+void contar_cola(int n, int perm[], uint64_t libres, uint64_t difs, uint64_t difs_inv, int pos,
+                 uint64_t difs_grandes, int pos_corte, double *nodos, double *soluciones) {
+    uint64_t candidatos = candidatos_de(libres, difs, difs_inv, perm[pos - 1]);
+    while (candidatos) {
+        int num = ctz64(candidatos);
+        candidatos &= candidatos - 1;
+        int diff = abs(num - perm[pos - 1]);
+        uint64_t l = libres & ~(1ULL << num), d = difs & ~(1ULL << diff);
+        perm[pos] = num;
+        *nodos += 1;
+        if (pos + 1 >= pos_corte && (d & (1ULL << (n - 1)))) continue;
+        if (pos + 1 == n) {
+            *soluciones += simetria ? peso_simetria(perm, n) : 1;
+            continue;
+        }
+        uint64_t disponibles = l | (1ULL << num), grandes = d & difs_grandes;
+        while (grandes && (disponibles & (disponibles >> ctz64(grandes)))) grandes &= grandes - 1;
+        if (grandes) continue;
+        contar_cola(n, perm, l, d, difs_inv & ~(1ULL << (63 - diff)), pos + 1, difs_grandes, pos_corte, nodos, soluciones);
+    }
+}
+
+void sondear(int n, uint64_t *semilla, double *nodos, double *soluciones) {
+    int perm[MAX_N + 1];
+    uint64_t libres = mascara_valores(n), difs = mascara_difs(n), difs_inv = mascara_difs_inv(n);
+    uint64_t difs_grandes = mascara_difs(n) & ~((1ULL << umbral_anticipacion) - 1);
+    int pos_corte = simetria ? (n - 2) / 2 + 2 : n + 1;
+    int centro2 = n + 1;  // Dos veces el centro, como en generar_prefijos
+    uint64_t candidatos = simetria ? libres & ((1ULL << (centro2 / 2 + 1)) - 1) : libres;
+    double factor = 1.0;
+    *nodos = 1.0;  // La raíz
+    *soluciones = 0.0;
+
+    for (int pos = 0; candidatos; ) {
+        int c = __builtin_popcountll(candidatos);
+        factor *= c;
+        *nodos += factor;  // Los c hijos se visitan (y se cuentan) aunque luego se poden
+
+        // Hijo al azar (xorshift64): se quitan k bits bajos y se toma el siguiente. k sale de
+        // multiplicar los 32 bits altos por c y quedarse con la parte alta, sin el sesgo de '% c'.
+        *semilla ^= *semilla << 13;
+        *semilla ^= *semilla >> 7;
+        *semilla ^= *semilla << 17;
+        for (int k = (int)(((*semilla >> 32) * (uint64_t)c) >> 32); k > 0; k--) candidatos &= candidatos - 1;
+        int num = ctz64(candidatos);
+        int diff = (pos == 0) ? 0 : abs(num - perm[pos - 1]);
+        perm[pos++] = num;
+        libres &= ~(1ULL << num);
+        difs &= ~(1ULL << diff);
+        difs_inv &= ~(1ULL << (63 - diff));
+
+        // Las mismas condiciones que al entrar a un nodo en backtrack_bits.
+        if (pos >= pos_corte && (difs & (1ULL << (n - 1)))) return;
+        if (pos == n) {
+            *soluciones = factor * (simetria ? peso_simetria(perm, n) : 1);
+            return;
+        }
+        uint64_t disponibles = libres | (1ULL << num);
+        for (uint64_t grandes = difs & difs_grandes; grandes; grandes &= grandes - 1) {
+            if ((disponibles & (disponibles >> ctz64(grandes))) == 0) return;
+        }
+        if (n - pos <= COLA_ESTIMACION && pos >= 2) {
+            double nodos_cola = 0, soluciones_cola = 0;
+            contar_cola(n, perm, libres, difs, difs_inv, pos, difs_grandes, pos_corte, &nodos_cola, &soluciones_cola);
+            *nodos += factor * nodos_cola;
+            *soluciones = factor * soluciones_cola;
+            return;
+        }
+        candidatos = candidatos_de(libres, difs, difs_inv, num);
+        if (simetria && pos == 1 && 2 * perm[0] == centro2) candidatos &= (1ULL << (centro2 / 2)) - 1;
+    }
+}
+
+// Mide cuántos nodos por segundo recorre un hilo, con una búsqueda real corta (el iterador se
+// puede detener en cualquier momento sin perder nada, así que basta con darle un presupuesto).
+double medir_velocidad(int n) {
+    gp_iter_t *it = malloc(sizeof(gp_iter_t));
+    int perm[MAX_N];
+    long long inicio = reloj_us(), transcurrido;
+    gp_iter_init(it, n, umbral_anticipacion);
+    do {
+        long long presupuesto = 100000;
+        while (gp_iter_next(it, perm, &presupuesto) == GP_SOLUCION) {}
+        transcurrido = reloj_us() - inicio;
+    } while (it->pos >= 0 && transcurrido < TIEMPO_CALIBRACION_US);
+    double velocidad = transcurrido > 0 ? gp_iter_nodos(it) * 1e6 / transcurrido : 0.0;
+    free(it);
+    return velocidad;
+}
+
+// Hace los sondeos y escribe las estimaciones con intervalos de confianza del 95 %.
+void estimar(int n, int tiempo) {
+    uint64_t semilla = (uint64_t)reloj_us() * 0x9E3779B97F4A7C15ULL | 1;
+    uint64_t semilla_inicial = semilla;
+    double media_nodos = 0, m2_nodos = 0, media_sol = 0, m2_sol = 0;
+
+    // Medias y varianzas con el método de Welford (las estimaciones pueden ser enormes).
+    for (long long k = 1; k <= sondeos; k++) {
+        double nodos, soluciones;
+        sondear(n, &semilla, &nodos, &soluciones);
+        double delta = nodos - media_nodos;
+        media_nodos += delta / k;
+        m2_nodos += delta * (nodos - media_nodos);
+        delta = soluciones - media_sol;
+        media_sol += delta / k;
+        m2_sol += delta * (soluciones - media_sol);
+    }
+    double error_nodos = sondeos > 1 ? 1.96 * sqrt(m2_nodos / (sondeos - 1) / sondeos) : 0.0;
+    double error_sol = sondeos > 1 ? 1.96 * sqrt(m2_sol / (sondeos - 1) / sondeos) : 0.0;
+    double velocidad = medir_velocidad(n) * (motor == MOTOR_BITS ? hilos : 1);  // Suponiendo escalado ideal
+    double segundos = velocidad > 0 ? media_nodos / velocidad : 0.0;
+    double error_segundos = velocidad > 0 ? error_nodos / velocidad : 0.0;
+    double inferior = media_nodos - error_nodos > 0 ? media_nodos - error_nodos : 0.0;
+
+    printf("Estimacion para n=%d con %lld sondeos%s:\n", n, sondeos, simetria ? " (con --simetria)" : "");
+    printf("  Nodos: %.4g (IC 95%%: %.4g a %.4g)\n", media_nodos, inferior, media_nodos + error_nodos);
+    if (media_sol > 0)
+        printf("  Permutaciones graciles: %.4g (IC 95%%: %.4g a %.4g)\n", media_sol,
+               media_sol - error_sol > 0 ? media_sol - error_sol : 0.0, media_sol + error_sol);
+    else
+        printf("  Permutaciones graciles: ningun sondeo llego a una solucion (hacen falta mas sondeos)\n");
+    printf("  Velocidad medida: %.3g nodos/s con %d hilo(s)\n", velocidad, motor == MOTOR_BITS ? hilos : 1);
+    printf("  Tiempo estimado: %.3g s (IC 95%%: %.3g a %.3g s); el limite dado es %d min.\n",
+           segundos, inferior / (velocidad > 0 ? velocidad : 1), segundos + error_segundos, tiempo);
+    fprintf(stderr, "{\"tipo\":\"estimacion\",\"n\":%d,\"simetria\":%s,\"anticipar\":%d,\"hilos\":%d,"
+            "\"sondeos\":%lld,\"semilla\":%llu,\"nodos\":%.6g,\"error_nodos\":%.6g,\"soluciones\":%.6g,"
+            "\"error_soluciones\":%.6g,\"nodos_por_s\":%.6g,\"segundos\":%.6g,\"error_segundos\":%.6g}\n",
+            n, simetria ? "true" : "false", umbral_anticipacion < n ? umbral_anticipacion : 0,
+            motor == MOTOR_BITS ? hilos : 1, sondeos, (unsigned long long)semilla_inicial, media_nodos, error_nodos,
+            media_sol, error_sol, velocidad, segundos, error_segundos);
+}
+
+// Muestras uniformes y acceso por índice (--sample, --unrank)
+/*Con la cantidad de soluciones de cada subárbol se baja directo a la permutación i en orden
+lexicográfico: en cada nivel se recorren los candidatos de menor a mayor restando de i la cuenta de
+cada hijo hasta dar con el que la contiene. Las cuentas salen de una pasada de un solo hilo que
+recorre el árbol una vez con su propia tabla de transposición, así que después cada consulta son n
+niveles de búsquedas en la tabla. Hasta MEMO_ORDEN_TODO_MAX se guarda todo subárbol de dos o más
+posiciones (con el umbral de --memo, n=8 recontaba ~1500 nodos por consulta y ahora ~20); más
+arriba los estados no caben en la tabla por defecto, los chicos desplazarían a los grandes y se
+vuelve a guardar solo desde MEMO_RESTANTES_MIN posiciones.
+Una muestra uniforme es la permutación de un índice elegido al azar en [0, total). Si la tabla
+perdió una entrada, su subárbol se vuelve a contar: la consulta sale más lenta, nunca distinta. Si
+el tiempo se agota en una consulta las cuentas dejan de valer y la consulta se abandona.*/
+memo_t tabla_orden;
+int n_orden;
+uint64_t difs_grandes_orden;  // Diferencias que revisa la poda por anticipación
+int restantes_min_orden;  // Posiciones libres desde las que un subárbol va a la tabla
+unsigned long long nodos_orden = 0;  // Nodos recorridos para contar (pasada inicial y consultas)
+
+unsigned long long contar_subarbol(uint64_t libres, uint64_t difs, uint64_t difs_inv, int ultimo, int pos);
+
+// Soluciones que hay debajo de colocar 'num' en la posición pos (0 si la poda lo descarta).
+unsigned long long contar_hijo(uint64_t libres, uint64_t difs, uint64_t difs_inv, int ultimo, int pos, int num) {
+    if (--presupuesto_global.nodos_restantes == 0) revisar_tiempo(&presupuesto_global);
+    if (tiempo_agotado) return 0;
+    nodos_orden++;
+    int diff = (pos == 0) ? 0 : abs(num - ultimo);  // La diferencia 0 nunca está en las máscaras
+    libres &= ~(1ULL << num);
+    difs &= ~(1ULL << diff);
+    difs_inv &= ~(1ULL << (63 - diff));
+    if (pos + 1 == n_orden) return 1;
+    uint64_t disponibles = libres | (1ULL << num), grandes = difs & difs_grandes_orden;
+    while (grandes && (disponibles & (disponibles >> ctz64(grandes)))) grandes &= grandes - 1;
+    if (grandes) return 0;
+    return contar_subarbol(libres, difs, difs_inv, num, pos + 1);
+}
+
+// Soluciones del subárbol de un nodo ya colocado (pos valores, el último es 'ultimo').
+unsigned long long contar_subarbol(uint64_t libres, uint64_t difs, uint64_t difs_inv, int ultimo, int pos) {
+    uint64_t clave = libres | (uint64_t)ultimo << 56, firma = difs | (uint64_t)n_orden << 56;
+    bool en_tabla = n_orden - pos >= restantes_min_orden;
+    unsigned long long cuenta = 0;
+    if (en_tabla && memo_buscar(&tabla_orden, clave, firma, &cuenta)) return cuenta;
+    for (uint64_t c = candidatos_de(libres, difs, difs_inv, ultimo); c; c &= c - 1)
+        cuenta += contar_hijo(libres, difs, difs_inv, ultimo, pos, ctz64(c));
+    if (en_tabla && !tiempo_agotado) memo_guardar(&tabla_orden, clave, firma, cuenta);
+    return cuenta;
+}
+
+// Deja en perm[] la permutación grácil 'indice' (desde 0) en orden lexicográfico; indice < total.
+// Devuelve false si el tiempo se agotó en el camino (perm[] queda a medias).
+bool permutacion_en(unsigned long long indice, int perm[]) {
+    int n = n_orden;
+    uint64_t libres = mascara_valores(n), difs = mascara_difs(n), difs_inv = mascara_difs_inv(n);
+    for (int pos = 0; pos < n; pos++) {
+        uint64_t c = (pos == 0) ? libres : candidatos_de(libres, difs, difs_inv, perm[pos - 1]);
+        for (; c; c &= c - 1) {
+            int num = ctz64(c);
+            unsigned long long cuenta = contar_hijo(libres, difs, difs_inv, pos ? perm[pos - 1] : 0, pos, num);
+            if (tiempo_agotado) return false;  // Una cuenta cortada vale 0 y el índice caería fuera
+            if (indice < cuenta) break;
+            indice -= cuenta;
+        }
+        if (c == 0) return false;  // Solo pasa con el índice fuera del total
+        int num = ctz64(c);
+        int diff = (pos == 0) ? 0 : abs(num - perm[pos - 1]);
+        perm[pos] = num;
+        libres &= ~(1ULL << num);
+        difs &= ~(1ULL << diff);
+        difs_inv &= ~(1ULL << (63 - diff));
+    }
+    return true;
+}
+
+// Número al azar uniforme en [0, total) (xorshift64, descartando la cola que sesgaría el módulo).
+unsigned long long al_azar(uint64_t *semilla, unsigned long long total) {
+    unsigned long long limite = UINT64_MAX - UINT64_MAX % total;
+    do {
+        *semilla ^= *semilla << 13;
+        *semilla ^= *semilla >> 7;
+        *semilla ^= *semilla << 17;
+    } while (*semilla >= limite);
+    return *semilla % total;
+}
+
+// Cuenta el árbol una vez y responde --unrank o --sample; devuelve el código de salida.
+int consultar_orden(int n) {
+    int perm[MAX_N + 1];
+    n_orden = n;
+    restantes_min_orden = n <= MEMO_ORDEN_TODO_MAX ? 2 : MEMO_RESTANTES_MIN;
+    difs_grandes_orden = mascara_difs(n) & ~((1ULL << umbral_anticipacion) - 1);
+    // Sin --memo, con n chico la tabla se achica con el árbol (los estados crecen ~3.5 veces por n):
+    // una tabla grande casi vacía cuesta más en fallos de página que lo que ahorra.
+    long long bytes_orden = MEMO_ORDEN_POR_DEFECTO_MB * 1024LL * 1024LL;
+    if (n < MEMO_ORDEN_TODO_MAX) bytes_orden >>= 3 * (MEMO_ORDEN_TODO_MAX - n) / 2;
+    memo_iniciar(&tabla_orden, memo_bytes > 0 ? memo_bytes : bytes_orden);
+    if (tabla_orden.num_cubetas == 0) {
+        printf("No hay memoria para la tabla de cuentas.\n");
+        return 1;
+    }
+
+    long long inicio = reloj_us();
+    unsigned long long total = 0;
+    uint64_t libres = mascara_valores(n);
+    for (uint64_t c = libres; c; c &= c - 1)
+        total += contar_hijo(libres, mascara_difs(n), mascara_difs_inv(n), 0, 0, ctz64(c));
+    long long conteo_us = reloj_us() - inicio;
+    unsigned long long nodos_conteo = nodos_orden;
+    if (tiempo_agotado) {
+        printf("Tiempo agotado antes de terminar de contar el arbol de n=%d.\n", n);
+        return 1;
+    }
+    if (indice_pedido >= total && muestras_pedidas == 0) {
+        printf("Hay %llu permutaciones graciles de n=%d: el indice va de 0 a %llu.\n", total, n, total - 1);
+        return 1;
+    }
+
+    uint64_t semilla = semilla_dada ? semilla_muestras : (uint64_t)reloj_us() * 0x9E3779B97F4A7C15ULL | 1;
+    uint64_t semilla_inicial = semilla;
+    long long consultas = muestras_pedidas > 0 ? muestras_pedidas : 1;
+    inicio = reloj_us();
+    for (long long k = 0; k < consultas; k++) {
+        if (!permutacion_en(muestras_pedidas > 0 ? al_azar(&semilla, total) : indice_pedido, perm)) {
+            printf("Tiempo agotado en la consulta %lld de %lld de n=%d.\n", k + 1, consultas, n);
+            free(tabla_orden.entradas);
+            return 1;
+        }
+        for (int i = 0; i < n; i++) printf(i ? " %d" : "%d", perm[i]);
+        putchar('\n');
+    }
+    long long consultas_us = reloj_us() - inicio;
+
+    fprintf(stderr, "{\"tipo\":\"%s\",\"n\":%d,\"anticipar\":%d,\"soluciones\":%llu,\"consultas\":%lld,"
+            "\"semilla\":%llu,\"conteo_us\":%lld,\"nodos_conteo\":%llu,\"consultas_us\":%lld,"
+            "\"nodos_por_consulta\":%.1f,\"memo\":{\"cubetas\":%llu,\"consultas\":%llu,\"aciertos\":%llu,"
+            "\"guardados\":%llu}}\n",
+            muestras_pedidas > 0 ? "muestras" : "indice", n, umbral_anticipacion < n ? umbral_anticipacion : 0,
+            total, consultas, muestras_pedidas > 0 ? (unsigned long long)semilla_inicial : 0ULL, conteo_us,
+            nodos_conteo, consultas_us, (double)(nodos_orden - nodos_conteo) / consultas,
+            (unsigned long long)tabla_orden.num_cubetas, tabla_orden.consultas, tabla_orden.aciertos,
+            tabla_orden.guardados);
+    free(tabla_orden.entradas);
+    return 0;
+}
+
+// Encuentro a mitad de camino (--motor mitad)
+/*Una permutación grácil p se parte en el valor de unión j = p[a-1]: la mitad izquierda p[0..a-1]
+(a valores, a-1 diferencias) y la derecha p[a-1..n-1] (b = n+1-a valores). Dos mitades encajan si
+y solo si comparten solo j y entre las dos usan todos los valores y todas las diferencias, o sea si
+la derecha tiene los valores (todos - V_izq) + {j} y las diferencias (todas - D_izq). Se cuentan
+las mitades derechas por firma (valores, diferencias, j) en una tabla hash y cada mitad izquierda
+suma las de la firma complementaria. Las dos mitades se generan como prefijos (la derecha se recorre
+desde p[n-1] hacia j), así que se les aplica la misma poda por anticipación que a backtrack_bits.
+Si las firmas no caben en mem_mitad_bytes, las dos mitades se reparten por hash de la firma en
+PARTICIONES_MITAD archivos temporales por lado y se cruzan partición por partición; si una partición
+tampoco cabe, se carga por bloques y la izquierda se relee una vez por bloque.*/
+typedef struct {
+    uint64_t clave;  // Valores usados | j << 56 (0: entrada vacía)
+    uint64_t difs;  // Diferencias usadas
+    unsigned long long cuenta;  // Mitades con esta firma
+} firma_t;
+
+typedef struct {
+    firma_t *entradas;
+    uint64_t capacidad;  // Potencia de 2
+    uint64_t ocupadas, max_ocupadas;  // Se llena hasta el 70 % para que el sondeo lineal sea corto
+} tabla_firmas_t;
+
+tabla_firmas_t tabla_mitad;
+bool mitad_derramada = false;  // Si las firmas se están escribiendo en particiones
+FILE *particiones_der[PARTICIONES_MITAD], *particiones_izq[PARTICIONES_MITAD];
+unsigned long long firmas_derechas = 0, mitades_izquierdas = 0, bytes_derramados = 0;
+
+static inline uint64_t hash_firma(uint64_t clave, uint64_t difs) {
+    uint64_t h = clave * 0x9E3779B97F4A7C15ULL ^ difs * 0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 31);
+}
+
+// Los bits altos del hash eligen la partición y los bajos la posición, así son independientes.
+static inline int particion_de(const firma_t *f) {
+    return (int)(hash_firma(f->clave, f->difs) >> 58) % PARTICIONES_MITAD;
+}
+
+void tabla_vaciar(tabla_firmas_t *t) {
+    memset(t->entradas, 0, t->capacidad * sizeof(firma_t));
+    t->ocupadas = 0;
+}
+
+// Suma 'cuenta' a la firma. Devuelve false si la firma es nueva y la tabla ya está llena.
+bool tabla_sumar(tabla_firmas_t *t, const firma_t *f) {
+    uint64_t i = hash_firma(f->clave, f->difs) & (t->capacidad - 1);
+    while (t->entradas[i].clave != 0) {
+        if (t->entradas[i].clave == f->clave && t->entradas[i].difs == f->difs) {
+            t->entradas[i].cuenta += f->cuenta;
+            return true;
+        }
+        i = (i + 1) & (t->capacidad - 1);
+    }
+    if (t->ocupadas >= t->max_ocupadas) return false;
+    t->entradas[i] = *f;
+    t->ocupadas++;
+    return true;
+}
+
+unsigned long long tabla_buscar(const tabla_firmas_t *t, const firma_t *f) {
+    uint64_t i = hash_firma(f->clave, f->difs) & (t->capacidad - 1);
+    while (t->entradas[i].clave != 0) {
+        if (t->entradas[i].clave == f->clave && t->entradas[i].difs == f->difs) return t->entradas[i].cuenta;
+        i = (i + 1) & (t->capacidad - 1);
+    }
+    return 0;
+}
+
+void escribir_firma(FILE *f, const firma_t *firma) {
+    if (fwrite(firma, sizeof(firma_t), 1, f) != 1) {
+        printf("No se pudo escribir en un archivo temporal del motor mitad.\n");
+        exit(1);
+    }
+    bytes_derramados += sizeof(firma_t);
+}
+
+// La tabla se llenó: se abren las particiones y se pasa a ellas todo lo que tenía.
+void derramar_tabla(void) {
+    for (int k = 0; k < PARTICIONES_MITAD; k++) {
+        particiones_der[k] = tmpfile();
+        particiones_izq[k] = tmpfile();
+        if (particiones_der[k] == NULL || particiones_izq[k] == NULL) {
+            fprintf(diagnosticos, "No se pudieron crear los archivos temporales del motor mitad.\n");
+            exit(1);
+        }
+    }
+    for (uint64_t i = 0; i < tabla_mitad.capacidad; i++) {
+        if (tabla_mitad.entradas[i].clave != 0)
+            escribir_firma(particiones_der[particion_de(&tabla_mitad.entradas[i])], &tabla_mitad.entradas[i]);
+    }
+    tabla_vaciar(&tabla_mitad);
+    mitad_derramada = true;
+}
+
+// Recibe una mitad completa: la derecha se guarda con su firma y la izquierda busca la complementaria.
+void emitir_mitad(int n, bool derecha, uint64_t libres, uint64_t difs, int j) {
+    firma_t f;
+    uint64_t valores = mascara_valores(n) & ~libres;
+    uint64_t usadas = mascara_difs(n) & ~difs;
+    f.cuenta = 1;
+    if (derecha) {
+        firmas_derechas++;
+        f.clave = valores | (uint64_t)j << 56;
+        f.difs = usadas;
+        if (!mitad_derramada && tabla_sumar(&tabla_mitad, &f)) return;
+        if (!mitad_derramada) derramar_tabla();
+        escribir_firma(particiones_der[particion_de(&f)], &f);
+    } else {
+        mitades_izquierdas++;
+        f.clave = (libres | (1ULL << j)) | (uint64_t)j << 56;  // Los valores que le faltan, más j
+        f.difs = difs;  // Las diferencias que le faltan
+        if (!mitad_derramada) contador += tabla_buscar(&tabla_mitad, &f);
+        else escribir_firma(particiones_izq[particion_de(&f)], &f);
+    }
+}
+
+// Genera todas las mitades de 'largo' valores (prefijos válidos, con la poda por anticipación).
+void enumerar_mitad(int n, int largo, bool derecha, int perm[], uint64_t libres, uint64_t difs,
+                    uint64_t difs_inv, int pos) {
+    if (--presupuesto_global.nodos_restantes == 0) {
+        revisar_tiempo(&presupuesto_global);
+        if (tiempo_agotado) return;
+        emitir_progreso_clasico();
+    }
+    estadisticas.nodos[pos]++;
+    nodos_visitados++;
+    if (pos == largo) {
+        // La otra mitad tiene justo los valores libres más j y tiene que realizar todas las diferencias
+        // que faltan: se revisan todas, no solo las grandes (cuesta poco y descarta muchas firmas).
+        uint64_t disponibles = libres | (1ULL << perm[pos - 1]);
+        for (uint64_t faltan = difs; faltan; faltan &= faltan - 1) {
+            if ((disponibles & (disponibles >> ctz64(faltan))) == 0) {
+                estadisticas.cortes_anticipacion[pos]++;
+                return;
+            }
+        }
+        emitir_mitad(n, derecha, libres, difs, perm[pos - 1]);
+        return;
+    }
+    uint64_t candidatos = libres;
+    if (pos > 0) {
+        uint64_t disponibles = libres | (1ULL << perm[pos - 1]);
+        for (uint64_t grandes = difs & ~((1ULL << umbral_anticipacion) - 1); grandes; grandes &= grandes - 1) {
+            if ((disponibles & (disponibles >> ctz64(grandes))) == 0) {
+                estadisticas.cortes_anticipacion[pos]++;
+                return;
+            }
+        }
+        candidatos = candidatos_de(libres, difs, difs_inv, perm[pos - 1]);
+    }
+    estadisticas.expandidos[pos]++;
+    while (candidatos) {
+        int num = ctz64(candidatos);
+        candidatos &= candidatos - 1;
+        int diff = (pos == 0) ? 0 : abs(num - perm[pos - 1]);
+        perm[pos] = num;
+        enumerar_mitad(n, largo, derecha, perm, libres & ~(1ULL << num), difs & ~(1ULL << diff),
+                       difs_inv & ~(1ULL << (63 - diff)), pos + 1);
+        if (tiempo_agotado) return;
+    }
+}
 
-// Función que calcula el factorial de un número entero positivo n.
-unsigned long long factorial(int n) {
-    // Variable para almacenar el resultado del factorial.
-    // Se usa 'unsigned long long' porque los valores factoriales pueden ser grandes.
-    unsigned long long resultado = 1;
+// Cruza una partición: carga la derecha en la tabla (por bloques si no cabe) y suma lo que busca la izquierda.
+void cruzar_particion(FILE *der, FILE *izq) {
+    firma_t f, g;
+    bool pendiente = false;  // 'f' se leyó pero no cupo en el bloque anterior
+    bool quedan = true;
+    rewind(der);
+    while (quedan) {
+        tabla_vaciar(&tabla_mitad);
+        if (pendiente) tabla_sumar(&tabla_mitad, &f);
+        pendiente = quedan = false;
+        while (fread(&f, sizeof(firma_t), 1, der) == 1) {
+            if (!tabla_sumar(&tabla_mitad, &f)) {
+                pendiente = quedan = true;
+                break;
+            }
+        }
+        // Una firma repartida entre dos bloques suma su parte en cada pasada, así que el total es exacto.
+        rewind(izq);
+        while (fread(&g, sizeof(firma_t), 1, izq) == 1) contador += tabla_buscar(&tabla_mitad, &g);
+    }
+}
 
-    // Bucle que multiplica desde 2 hasta n.
-    // Se omite multiplicar por 1 porque no cambia el resultado.
-    for (int i = 2; i <= n; i++) {
-        resultado *= i; // Acumulación del producto factorial.
+// Conteo con el encuentro a mitad de camino (n >= 2).
+unsigned long long contar_mitad(int n) {
+    int perm[MAX_N + 1];
+    int a = (n + 2) / 2, b = n + 1 - a;  // Valores de cada mitad (j está en las dos)
+
+    uint64_t capacidad = 1;
+    while ((long long)(capacidad * 2 * sizeof(firma_t)) <= mem_mitad_bytes) capacidad *= 2;
+    tabla_mitad.entradas = calloc(capacidad, sizeof(firma_t));
+    if (tabla_mitad.entradas == NULL) {
+        fprintf(diagnosticos, "No hay memoria para la tabla de firmas (%lld MB).\n", mem_mitad_bytes >> 20);
+        exit(1);
     }
+    tabla_mitad.capacidad = capacidad;
+    tabla_mitad.max_ocupadas = capacidad * 7 / 10;
+    tabla_mitad.ocupadas = 0;
+    mitad_derramada = false;  // Con --range se cuentan varios n en el mismo proceso
+    firmas_derechas = mitades_izquierdas = bytes_derramados = 0;
 
-    return resultado; // Devuelve el valor final de n!
+    contador = 0;
+    nodos_visitados = 0;
+    enumerar_mitad(n, b, true, perm, mascara_valores(n), mascara_difs(n), mascara_difs_inv(n), 0);
+    if (!tiempo_agotado)
+        enumerar_mitad(n, a, false, perm, mascara_valores(n), mascara_difs(n), mascara_difs_inv(n), 0);
+    if (mitad_derramada) {
+        for (int k = 0; k < PARTICIONES_MITAD; k++) {
+            if (!tiempo_agotado) cruzar_particion(particiones_der[k], particiones_izq[k]);
+            fclose(particiones_der[k]);
+            fclose(particiones_izq[k]);
+        }
+    }
+    deducir_rechazos(n);
+
+    fprintf(diagnosticos, "Motor mitad: mitades de %d y %d valores, %llu derechas, %llu izquierdas, tabla de %.1f MB%s",
+            a, b, firmas_derechas, mitades_izquierdas, capacidad * sizeof(firma_t) / (1024.0 * 1024.0),
+            mitad_derramada ? "" : ".\n");
+    if (mitad_derramada)
+        fprintf(diagnosticos, ", %.1f MB derramados en %d particiones por lado.\n", bytes_derramados / (1024.0 * 1024.0),
+                PARTICIONES_MITAD);
+    free(tabla_mitad.entradas);
+    return contador;
 }
 
-// Función recursiva que implementa el algoritmo de backtracking con poda.
-// Parámetros:
-// - perm[]: Arreglo que almacena la permutación parcial construida.
-// - usado[]: Arreglo booleano que indica qué números ya han sido utilizados en la permutación actual.
-// - diferencias[]: Arreglo booleano que marca qué diferencias entre elementos consecutivos ya han aparecido.
-// - n: Tamaño de la permutación a generar.
-// - pos: Índice actual dentro de la permutación.
-void backtrack(int perm[], bool usado[], bool diferencias[], int n, int pos) {
-    
-    // Variable para almacenar el tiempo actual del sistema.
-    LARGE_INTEGER actual;
-    QueryPerformanceCounter(&actual);
+// Motor de diferencias primero (--motor diferencias)
+/*Una permutación grácil es un camino que pasa por los valores 1..n y usa cada diferencia 1..n-1
+exactamente una vez. Este motor no coloca valores de izquierda a derecha: asigna las diferencias de
+la mayor a la menor, eligiendo para cada diferencia d la arista {a, a+d} que la realiza. La
+diferencia n-1 solo cabe en {1, n} y las grandes tienen muy pocos pares posibles, así que las
+restricciones más escasas se resuelven primero y las ramas muertas se cortan cerca de la raíz.
 
-    // Cálculo del tiempo transcurrido desde que se inició la ejecución.
-    long long tiempo_transcurrido = (actual.QuadPart - comienzo.QuadPart) * 1000000LL / frecuencia.QuadPart;
-    
-    // Verifica si el tiempo límite se ha alcanzado.
-    if (tiempo_transcurrido >= tiempo_limite) {
-        tiempo_agotado = true;  // Marca que el tiempo se ha agotado.
-        return;  // Finaliza la ejecución de esta rama de búsqueda.
+Una arista es legal si sus dos extremos tienen menos de dos vecinos y no están ya en el mismo
+fragmento (cerraría un ciclo). Con n-1 aristas, grado <= 2 y sin ciclos el grafo es un único camino
+por los n valores, que se puede leer en los dos sentidos: cada hoja vale 2 permutaciones.
+Los fragmentos se siguen con 'otro_extremo': para el extremo de un fragmento, el extremo opuesto.
+
+La profundidad es el número de diferencias asignadas. En las estadísticas, rechazo_usado cuenta los
+pares con un extremo que ya tiene dos vecinos y rechazo_dif los que cerrarían un ciclo.*/
+int otro_extremo[MAX_N + 2];
+
+// 'abiertos': valores con menos de dos vecinos; 'aislados': valores sin vecinos.
+void backtrack_diferencias(int n, int d, uint64_t abiertos, uint64_t aislados) {
+    int pos = n - 1 - d;  // Diferencias ya asignadas
+    if (--presupuesto_global.nodos_restantes == 0) {
+        revisar_tiempo(&presupuesto_global);
+        if (tiempo_agotado) return;
+        emitir_progreso_clasico();
     }
-    
-    // Caso base: Si hemos llenado toda la permutación, contamos esta como válida.
-    // Cuando pos == n, significa que hemos colocado n números en perm[], es decir, 
-    // hemos generado una permutación completa.
-    if (pos == n) {
-        contador++;  // Incrementa el contador de permutaciones válidas.
-        return;  // Finaliza esta rama de la recursión.
+    estadisticas.nodos[pos]++;
+    nodos_visitados++;
+    if (d == 0) {
+        contador += 2;  // El camino y su reverso
+        return;
     }
 
-    // Bucle que intenta colocar cada número del 1 al n en la permutación.
-    for (int num = 1; num <= n; num++) {
-        
-        // Verifica si el número ya ha sido utilizado en la permutación actual.
-        if (!usado[num]) {  
+    // Pares {a, a+d} con los dos extremos abiertos (el bit a de 'candidatos')
+    uint64_t candidatos = abiertos & (abiertos >> d);
+    estadisticas.expandidos[pos]++;
+    estadisticas.rechazo_usado[pos] += (n - d) - __builtin_popcountll(candidatos);
+    unsigned long long hijos = estadisticas.nodos[pos + 1];
+    while (candidatos) {
+        int a = ctz64(candidatos), b = a + d;
+        candidatos &= candidatos - 1;
+        if (otro_extremo[a] == b) {
+            estadisticas.rechazo_dif[pos]++;
+            continue;
+        }
 
-            // Si no es el primer número, verificar restricciones de diferencias.
-            if (pos > 0) {  // Ya se han colocado al menos dos números en la permutación.
-                int diff = abs(num - perm[pos - 1]);  // Calcula la diferencia absoluta con el número anterior.
-                
-                // Si la diferencia ya se ha usado o es inválida, descartar esta opción (poda).
-                // La diferencia no va a ser cero, n puede ser mayor o igual a n o ya fue usada.
-                if (diff < 1 || diff >= n || diferencias[diff]) {
-                    continue; // Se salta esta iteración del bucle y prueba otro número.
-                }
-                
-                // Marca la diferencia como utilizada en esta rama de la recursión.
-                diferencias[diff] = true;  
+        // Unir los fragmentos de a y b: sus extremos opuestos pasan a ser los extremos del nuevo.
+        int ea = otro_extremo[a], eb = otro_extremo[b];
+        uint64_t nuevos_abiertos = abiertos;
+        if (!(aislados & (1ULL << a))) nuevos_abiertos &= ~(1ULL << a);  // a ya tenía un vecino
+        if (!(aislados & (1ULL << b))) nuevos_abiertos &= ~(1ULL << b);
+        otro_extremo[ea] = eb;
+        otro_extremo[eb] = ea;
+        backtrack_diferencias(n, d - 1, nuevos_abiertos, aislados & ~(1ULL << a) & ~(1ULL << b));
+        otro_extremo[ea] = a;  // Deshacer (si a estaba aislado, ea == a y queda como antes)
+        otro_extremo[eb] = b;
+        otro_extremo[a] = ea;
+        otro_extremo[b] = eb;
+        if (tiempo_agotado) return;
+    }
+    if (estadisticas.nodos[pos + 1] == hijos) estadisticas.sin_salida[pos]++;
+}
+
+// Conteo con el motor de diferencias primero (n >= 2).
+unsigned long long contar_diferencias(int n) {
+    for (int v = 1; v <= n; v++) otro_extremo[v] = v;  // Cada valor es un fragmento de un solo valor
+    contador = 0;
+    nodos_visitados = 0;
+    backtrack_diferencias(n, n - 1, mascara_valores(n), mascara_valores(n));
+    return contador;
+}
+
+// Motor de carriles (--motor carriles)
+/*Recorre CARRILES subárboles independientes a la vez, uno por carril de un registro vectorial, con
+las mismas máscaras que backtrack_bits. En cada paso todos los carriles avanzan juntos: los que
+tienen candidatos pendientes bajan al menor (ctz vectorial por conversión a double), y los que no
+suben un nivel deshaciendo el último valor. Cada carril tiene su propia pila, guardada como
+[nivel][carril] para que apilar y desapilar sean scatters y gathers sin conflictos; un carril que
+no apila escribe en una fila de descarte. Cuando un carril termina su subárbol toma el siguiente
+prefijo de la lista (generada como en contar_bits, con la misma poda por anticipación).
+
+El cuerpo se escribe una vez con vectores de GCC y se compila para AVX-512, AVX2 y sin extensiones;
+la versión se elige al arrancar según la CPU (o con --isa). Un solo hilo.*/
+#define CARRILES 8
+#define FILA_DESCARTE (MAX_N + 2)  // Fila de las pilas donde escriben los carriles que no apilan
+
+typedef uint64_t carril_t __attribute__((vector_size(CARRILES * sizeof(uint64_t))));
+typedef int64_t carril_s_t __attribute__((vector_size(CARRILES * sizeof(int64_t))));
+typedef double carril_f_t __attribute__((vector_size(CARRILES * sizeof(double))));
+
+// Estado de los carriles. Va aparte de las pilas para que, copiado en una variable local, el
+// compilador sepa que escribir en las pilas no lo modifica y lo mantenga en registros.
+typedef struct {
+    carril_t libres, difs, difs_inv, candidatos, ultimo, pos, base;
+    carril_t activos;  // Todo en 1 si el carril tiene un subárbol asignado
+    carril_t soluciones;
+} estado_carriles_t;
+
+typedef struct {
+    int n;
+    estado_carriles_t e;
+    uint64_t pila_candidatos[(FILA_DESCARTE + 1) * CARRILES];  // Candidatos pendientes de cada nivel
+    uint64_t pila_perm[(FILA_DESCARTE + 1) * CARRILES];  // Valor colocado en cada posición
+    uint64_t nodos[(FILA_DESCARTE + 1) * CARRILES];  // Nodos por profundidad y carril
+    uint64_t cortes[(FILA_DESCARTE + 1) * CARRILES];  // Cortes por anticipación por profundidad y carril
+    tarea_t *tareas;
+    long long num_tareas, siguiente;
+    unsigned long long pasos, carriles_ocupados;
+} carriles_t;
+
+const char *isa_carriles = NULL;  // --isa: avx512, avx2 o generico (NULL: la mejor disponible)
+
+// Asigna al carril l el siguiente prefijo; si no quedan, lo desactiva.
+void cargar_carril(carriles_t *c, int l) {
+    if (c->siguiente == c->num_tareas) {
+        c->e.activos[l] = 0;
+        c->e.candidatos[l] = 0;
+        return;
+    }
+    const tarea_t *t = &c->tareas[c->siguiente++];
+    uint64_t libres = mascara_valores(c->n), difs = mascara_difs(c->n), difs_inv = mascara_difs_inv(c->n);
+    for (int i = 0; i < t->len; i++) {
+        int num = t->valores[i];
+        c->pila_perm[i * CARRILES + l] = num;
+        libres &= ~(1ULL << num);
+        if (i > 0) {
+            int diff = abs(num - t->valores[i - 1]);
+            difs &= ~(1ULL << diff);
+            difs_inv &= ~(1ULL << (63 - diff));
+        }
+    }
+    int ultimo = t->valores[t->len - 1];
+    c->e.libres[l] = libres;
+    c->e.difs[l] = difs;
+    c->e.difs_inv[l] = difs_inv;
+    c->e.ultimo[l] = ultimo;
+    c->e.pos[l] = c->e.base[l] = t->len;
+    c->e.candidatos[l] = candidatos_de(libres, difs, difs_inv, ultimo);
+    c->e.activos[l] = ~0ULL;
+}
+
+// Como macros y no como funciones: pasar vectores de 512 bits por valor cambia de ABI según la ISA.
+#define MEZCLAR(m, si, no) (((m) & (si)) | (~(m) & (no)))  // si donde m está en 1, no donde está en 0
+
+static inline bool alguno(const carril_t *m) {
+    uint64_t r = 0;
+    for (int l = 0; l < CARRILES; l++) r |= (*m)[l];
+    return r != 0;
+}
+
+// Un paso de todos los carriles. Se inserta en cada versión, así cada una se compila para su ISA.
+static inline __attribute__((always_inline)) void paso_carriles(carriles_t *c, estado_carriles_t *e, int umbral) {
+    const carril_t cero = {0}, uno = cero + 1;
+    carril_t indice_carril;
+    for (int l = 0; l < CARRILES; l++) indice_carril[l] = l;
+    carril_t hay = (carril_t)(e->candidatos != 0);
+    carril_t sube = e->activos & ~hay, baja = e->activos & hay;
+
+    // Bajar: el menor candidato, como en expandir_bits.
+    carril_t menor = e->candidatos & -e->candidatos;
+    carril_f_t como_double = __builtin_convertvector((carril_s_t)menor, carril_f_t);
+    carril_t num = MEZCLAR(baja, ((carril_t)como_double >> 52) - 1023, cero);
+    carril_t fila = MEZCLAR(baja, e->pos * CARRILES + indice_carril, FILA_DESCARTE * CARRILES + indice_carril);
+    for (int l = 0; l < CARRILES; l++) {
+        c->pila_candidatos[fila[l]] = e->candidatos[l] & (e->candidatos[l] - 1);
+        c->pila_perm[fila[l]] = num[l];
+    }
+    carril_s_t resta = (carril_s_t)num - (carril_s_t)e->ultimo;
+    carril_t diff = MEZCLAR(baja, (carril_t)((resta ^ (resta >> 63)) - (resta >> 63)), cero);
+    carril_t libres = e->libres & ~(uno << num);
+    carril_t difs = e->difs & ~(uno << diff);
+    carril_t difs_inv = e->difs_inv & ~(uno << (63 - diff));
+    carril_t pos = e->pos + 1;
+    carril_t hoja = (carril_t)(pos == (uint64_t)c->n);
+    e->soluciones += baja & hoja & uno;
+
+    // Poda por anticipación, diferencia por diferencia (el umbral es el mismo en todos los carriles).
+    carril_t disponibles = libres | (uno << num), malo = cero;
+    for (int d = umbral; d < c->n; d++) {
+        malo |= (carril_t)((disponibles & (disponibles >> d)) == 0) & -((difs >> d) & uno);
+    }
+    malo &= ~hoja;
+    carril_t candidatos = ((difs << num) | (difs_inv >> (63 - num))) & libres & ~hoja & ~malo;
+
+    // Contadores por profundidad: cada carril toca su propia columna, así que no hay conflictos.
+    carril_t fila_hijo = MEZCLAR(baja, pos * CARRILES + indice_carril, FILA_DESCARTE * CARRILES + indice_carril);
+    for (int l = 0; l < CARRILES; l++) {
+        c->nodos[fila_hijo[l]] += 1;
+        c->cortes[fila_hijo[l]] += malo[l] & 1;
+    }
+
+    // Subir: se deshace el último valor con el anterior, que está en la pila (pos >= base + 1 >= 2).
+    carril_t fila_anterior = MEZCLAR(sube, (e->pos - 2) * CARRILES + indice_carril, indice_carril);
+    carril_t fila_padre = MEZCLAR(sube, (e->pos - 1) * CARRILES + indice_carril, indice_carril);
+    carril_t anterior, pendientes;
+    for (int l = 0; l < CARRILES; l++) {
+        anterior[l] = c->pila_perm[fila_anterior[l]];
+        pendientes[l] = c->pila_candidatos[fila_padre[l]];
+    }
+    carril_s_t resta_sube = (carril_s_t)e->ultimo - (carril_s_t)anterior;
+    carril_t diff_sube = MEZCLAR(sube, (carril_t)((resta_sube ^ (resta_sube >> 63)) - (resta_sube >> 63)), cero);
+    carril_t ultimo_sube = MEZCLAR(sube, e->ultimo, cero);
+    carril_t libres_sube = e->libres | (uno << ultimo_sube);
+    carril_t difs_sube = e->difs | (uno << diff_sube);
+    carril_t difs_inv_sube = e->difs_inv | (uno << (63 - diff_sube));
+
+    e->libres = MEZCLAR(baja, libres, MEZCLAR(sube, libres_sube, e->libres));
+    e->difs = MEZCLAR(baja, difs, MEZCLAR(sube, difs_sube, e->difs));
+    e->difs_inv = MEZCLAR(baja, difs_inv, MEZCLAR(sube, difs_inv_sube, e->difs_inv));
+    e->candidatos = MEZCLAR(baja, candidatos, MEZCLAR(sube, pendientes, e->candidatos));
+    e->ultimo = MEZCLAR(baja, num, MEZCLAR(sube, anterior, e->ultimo));
+    e->pos = MEZCLAR(baja, pos, MEZCLAR(sube, e->pos - 1, e->pos));
+}
+
+// Ciclo completo hasta que no quedan carriles activos (o se agota el tiempo).
+static inline __attribute__((always_inline)) void recorrer_carriles(carriles_t *c) {
+    int umbral = umbral_anticipacion;
+    estado_carriles_t e = c->e;
+    while (alguno(&e.activos)) {
+        // Carriles que volvieron a la raíz de su subárbol sin candidatos: toman otro prefijo.
+        carril_t terminado = e.activos & (carril_t)(e.candidatos == 0) & (carril_t)(e.pos == e.base);
+        if (alguno(&terminado)) {
+            c->e = e;
+            for (int l = 0; l < CARRILES; l++) {
+                if (terminado[l]) cargar_carril(c, l);
             }
-            
-            // Asigna el número a la posición actual en la permutación.
-            perm[pos] = num;
-            usado[num] = true;  // Marca el número como utilizado.
+            e = c->e;
+            continue;  // Un prefijo recién cargado puede no tener candidatos
+        }
+        paso_carriles(c, &e, umbral);
+        c->pasos++;
+        for (int l = 0; l < CARRILES; l++) c->carriles_ocupados += e.activos[l] & 1;
 
-            // Llamado recursivo para llenar la siguiente posición.
-            backtrack(perm, usado, diferencias, n, pos + 1);
-            
-            // Si se agotó el tiempo en la recursión, terminar la búsqueda.
-            if (tiempo_agotado) return;
+        presupuesto_global.nodos_restantes -= CARRILES;
+        if (presupuesto_global.nodos_restantes <= 0) {
+            revisar_tiempo(&presupuesto_global);
+            if (tiempo_agotado) break;
+            if (intervalo_progreso_us > 0 && presupuesto_global.ultima_revision - ultimo_progreso >= intervalo_progreso_us) {
+                unsigned long long nodos = 0;
+                for (int i = 0; i <= MAX_N * CARRILES; i++) nodos += c->nodos[i];
+                unsigned long long soluciones = contador;
+                for (int l = 0; l < CARRILES; l++) soluciones += e.soluciones[l];
+                emitir_progreso(nodos_visitados + nodos, soluciones, c->num_tareas - c->siguiente);
+            }
+        }
+    }
+    c->e = e;
+}
 
-            // *** RETROCESO (Backtracking) ***
-            // Se deshacen los cambios y se regresa a la llamada anterior de la recursión para probar una nueva opción.
-            // Deshacer cambios para explorar otra posible solución.
-            usado[num] = false;  // Marca el número como disponible nuevamente.
-            
-            // Si se usó una diferencia, se desmarca para permitir nuevas combinaciones.
-            if (pos > 0) {
-                diferencias[abs(num - perm[pos - 1])] = false;
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx512f,avx512dq,avx512vl,avx512cd")))
+void recorrer_carriles_avx512(carriles_t *c) { recorrer_carriles(c); }
+
+__attribute__((target("avx2")))
+void recorrer_carriles_avx2(carriles_t *c) { recorrer_carriles(c); }
+#endif
+
+void recorrer_carriles_generico(carriles_t *c) { recorrer_carriles(c); }
+
+// Contador de ciclos del procesador (0 si no hay uno al alcance).
+static inline unsigned long long ciclos(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Lista los prefijos de longitud 'profundidad' que sobreviven a la poda (contando sus nodos).
+void listar_prefijos(carriles_t *c, int profundidad, int perm[], uint64_t libres, uint64_t difs,
+                     uint64_t difs_inv, int pos, long long *capacidad) {
+    int n = c->n;
+    estadisticas.nodos[pos]++;
+    if (pos == n) {
+        contador++;
+        return;
+    }
+    if (pos > 0) {
+        uint64_t disponibles = libres | (1ULL << perm[pos - 1]);
+        for (uint64_t grandes = difs & ~((1ULL << umbral_anticipacion) - 1); grandes; grandes &= grandes - 1) {
+            if ((disponibles & (disponibles >> ctz64(grandes))) == 0) {
+                estadisticas.cortes_anticipacion[pos]++;
+                return;
             }
         }
     }
+    if (pos == profundidad) {
+        if (c->num_tareas == *capacidad) {
+            *capacidad *= 2;
+            c->tareas = realloc(c->tareas, *capacidad * sizeof(tarea_t));
+        }
+        c->tareas[c->num_tareas].len = pos;
+        for (int i = 0; i < pos; i++) c->tareas[c->num_tareas].valores[i] = perm[i];
+        c->num_tareas++;
+        return;
+    }
+    uint64_t candidatos = (pos == 0) ? libres : candidatos_de(libres, difs, difs_inv, perm[pos - 1]);
+    while (candidatos) {
+        int num = ctz64(candidatos);
+        candidatos &= candidatos - 1;
+        int diff = (pos == 0) ? 0 : abs(num - perm[pos - 1]);
+        perm[pos] = num;
+        listar_prefijos(c, profundidad, perm, libres & ~(1ULL << num), difs & ~(1ULL << diff),
+                        difs_inv & ~(1ULL << (63 - diff)), pos + 1, capacidad);
+    }
+}
+
+// Conteo con el motor de carriles (n >= 2).
+unsigned long long contar_carriles(int n) {
+    int perm[MAX_N + 1];
+    carriles_t *c = aligned_alloc(64, (sizeof(carriles_t) + 63) / 64 * 64);
+    memset(c, 0, sizeof(carriles_t));
+    c->n = n;
+    int profundidad = profundidad_division;
+    if (profundidad < 1) profundidad = 1;
+    if (profundidad > n) profundidad = n;
+    long long capacidad = 1024;
+    c->tareas = malloc(capacidad * sizeof(tarea_t));
+    contador = 0;
+    listar_prefijos(c, profundidad, perm, mascara_valores(n), mascara_difs(n), mascara_difs_inv(n), 0, &capacidad);
+
+    // La mejor versión disponible, salvo que --isa pida otra.
+    void (*recorrer)(carriles_t *) = recorrer_carriles_generico;
+    const char *isa = "generico";
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    bool hay_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+                   && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512cd");
+    bool hay_avx2 = __builtin_cpu_supports("avx2");
+    if (isa_carriles == NULL ? hay_avx512 : strcmp(isa_carriles, "avx512") == 0 && hay_avx512) {
+        recorrer = recorrer_carriles_avx512;
+        isa = "avx512";
+    } else if (isa_carriles == NULL ? hay_avx2 : strcmp(isa_carriles, "avx2") == 0 && hay_avx2) {
+        recorrer = recorrer_carriles_avx2;
+        isa = "avx2";
+    }
+#endif
+    if (isa_carriles != NULL && strcmp(isa_carriles, isa) != 0)
+        fprintf(diagnosticos, "La CPU no tiene %s: se usa la version %s.\n", isa_carriles, isa);
+
+    for (int l = 0; l < CARRILES; l++) cargar_carril(c, l);
+    unsigned long long ciclos_inicio = ciclos();
+    recorrer(c);
+    unsigned long long ciclos_total = ciclos() - ciclos_inicio;
+
+    unsigned long long nodos_carriles = 0;
+    for (int l = 0; l < CARRILES; l++) contador += c->e.soluciones[l];
+    for (int d = 0; d <= MAX_N + 1; d++) {
+        for (int l = 0; l < CARRILES; l++) {
+            estadisticas.nodos[d] += c->nodos[d * CARRILES + l];
+            estadisticas.cortes_anticipacion[d] += c->cortes[d * CARRILES + l];
+            nodos_carriles += c->nodos[d * CARRILES + l];
+        }
+    }
+    nodos_visitados = nodos_de(&estadisticas);
+
+    fprintf(diagnosticos, "Motor carriles (%s, %d carriles): %llu pasos, %.1f%% de carriles ocupados", isa, CARRILES,
+            c->pasos, c->pasos ? 100.0 * c->carriles_ocupados / (c->pasos * (double)CARRILES) : 0.0);
+    if (ciclos_total > 0 && nodos_carriles > 0)
+        fprintf(diagnosticos, ", %.4f nodos por ciclo por carril (%.2f ciclos por nodo).\n",
+                nodos_carriles / ((double)ciclos_total * CARRILES), (double)ciclos_total / nodos_carriles);
+    else
+        fprintf(diagnosticos, ".\n");
+    free(c->tareas);
+    free(c);
+    return contador;
 }
 
+// Conteo por fuerza bruta: recorre las n! permutaciones en orden lexicográfico y verifica cada una.
+// Solo sirve para n pequeños y se usa para comprobar los motores (--comprobar).
+unsigned long long contar_fuerza_bruta(int n) {
+    int p[MAX_N + 1];
+    unsigned long long total = 0;
+    for (int i = 0; i < n; i++) p[i] = i + 1;
+    while (true) {
+        uint64_t vistas = 0;
+        int i;
+        for (i = 1; i < n; i++) {
+            uint64_t bit = 1ULL << abs(p[i] - p[i - 1]);
+            if (vistas & bit) break;
+            vistas |= bit;
+        }
+        if (i == n) total++;
+
+        // Siguiente permutación en orden lexicográfico.
+        int k = n - 2;
+        while (k >= 0 && p[k] > p[k + 1]) k--;
+        if (k < 0) break;
+        int l = n - 1;
+        while (p[l] < p[k]) l--;
+        int tmp = p[k]; p[k] = p[l]; p[l] = tmp;
+        for (int a = k + 1, b = n - 1; a < b; a++, b--) {
+            tmp = p[a]; p[a] = p[b]; p[b] = tmp;
+        }
+    }
+    return total;
+}
 
 // Función principal para contar permutaciones gráciles
-int contar_permutaciones_graciles(int n) {
+unsigned long long contar_permutaciones_graciles(int n) {
+    if (motor == MOTOR_ITERATIVO) return contar_iterativo(n);  // También cubre n=1 (y lo lista)
     if (n == 1) return 1;  // Caso especial para n=1
+    if (motor == MOTOR_BITS) return contar_bits(n);
+    if (motor == MOTOR_MITAD) return contar_mitad(n);
+    if (motor == MOTOR_DIFERENCIAS) return contar_diferencias(n);
+    if (motor == MOTOR_CARRILES) return contar_carriles(n);
 
     // Asignación de memoria dinámica para estructuras de datos
     /*Se usa malloc y no arreglos estáticos por:
@@ -149,29 +2870,613 @@ int contar_permutaciones_graciles(int n) {
     return contador;
 }
 
+// Barrido de --range con los demás motores: un n tras otro, del más grande al más chico.
+void contar_rango_secuencial(int desde, int hasta, fila_rango_t filas[]) {
+    int pedido = umbral_anticipacion;
+    for (int n = hasta; n >= desde; n--) {
+        if (tiempo_agotado) {
+            filas[n].incompleto = true;
+            continue;
+        }
+        memset(&estadisticas, 0, sizeof(estadisticas));
+        umbral_anticipacion = resolver_umbral(pedido, n);
+        long long inicio = reloj_us();
+        filas[n].soluciones = contar_permutaciones_graciles(n);
+        filas[n].tiempo_us = reloj_us() - inicio;
+        filas[n].nodos = motor == MOTOR_CLASICO ? nodos_de(&estadisticas) : nodos_visitados;
+        filas[n].incompleto = tiempo_agotado;
+    }
+    umbral_anticipacion = pedido;
+}
+
+// Escribe la tabla de --range: CSV en stdout (una fila por n) y una línea JSON en stderr.
+void emitir_rango(int desde, int hasta, const fila_rango_t filas[], long long microsec) {
+    bool completo = true;
+    printf("n,soluciones,nodos,tiempo_us,nodos_por_s,completo\n");
+    for (int n = desde; n <= hasta; n++) {
+        const fila_rango_t *f = &filas[n];
+        completo = completo && !f->incompleto;
+        printf("%d,%llu,%llu,%lld,%.0f,%d\n", n, f->soluciones, f->nodos, f->tiempo_us,
+               f->tiempo_us > 0 ? f->nodos * 1e6 / f->tiempo_us : 0.0, f->incompleto ? 0 : 1);
+    }
+    printf("# %d valores de n en %lld [us] de pared con %d hilo(s)\n", hasta - desde + 1, microsec,
+           motor == MOTOR_BITS ? hilos : 1);
+
+    fprintf(stderr, "{\"tipo\":\"rango\",\"desde\":%d,\"hasta\":%d,\"motor\":\"%s\",\"hilos\":%d,\"simetria\":%s,"
+            "\"completo\":%s,\"tiempo_us\":%lld,\"filas\":[", desde, hasta, nombres_motor[motor],
+            motor == MOTOR_BITS ? hilos : 1, simetria ? "true" : "false", completo ? "true" : "false", microsec);
+    for (int n = desde; n <= hasta; n++) {
+        const fila_rango_t *f = &filas[n];
+        fprintf(stderr, "%s{\"n\":%d,\"soluciones\":%llu,\"nodos\":%llu,\"tiempo_us\":%lld,\"nodos_por_s\":%.0f,"
+                "\"completo\":%s}", n > desde ? "," : "", n, f->soluciones, f->nodos, f->tiempo_us,
+                f->tiempo_us > 0 ? f->nodos * 1e6 / f->tiempo_us : 0.0, f->incompleto ? "false" : "true");
+    }
+    fprintf(stderr, "]}\n");
+}
+
+// Escribe en stderr la línea JSON de resumen con los contadores por profundidad.
+// Nodos de la ejecución: el motor clásico los lleva solo en las estadísticas.
+unsigned long long nodos_totales(void) {
+    if (motor != MOTOR_CLASICO) return nodos_visitados;  // Incluye los nodos de ejecuciones anteriores (--resume)
+    return nodos_de(&estadisticas);
+}
+
+// Bandas de --perf
+/*Cada banda se queda con la parte del total de cada contador que dicen sus muestras. La banda
+"reparto" es lo que pasa fuera de los subárboles de las tareas: generar los prefijos, sacar y robar
+tareas y esperar trabajo. Con los motores que no son el de bits solo hay la fila del total.*/
+typedef struct {
+    const char *nombre;
+    int desde, hasta;  // Profundidades de la banda (-1: no corresponde a niveles del árbol)
+    double nodos;
+    double eventos[EVENTOS_PERF];
+    unsigned long long muestras;  // Muestras del reloj que cayeron en la banda
+} banda_perf_t;
+
+int bandas_perf(int n, banda_perf_t bandas[]) {
+    static const char *nombres[BANDAS_PERF + 1] = {"reparto", "banda 1", "banda 2", "banda 3", "banda 4"};
+    unsigned long long muestras[EVENTOS_PERF] = {0};
+    for (int b = 0; b <= BANDAS_PERF; b++)
+        for (int e = 0; e < EVENTOS_PERF; e++) muestras[e] += perf_muestras[b][e];
+
+    int num = 0;
+    bandas[num] = (banda_perf_t){"total", 0, n, (double)nodos_totales(), {0}, muestras[PERF_RELOJ]};
+    memcpy(bandas[num++].eventos, perf_total, sizeof(perf_total));
+    if (motor != MOTOR_BITS) return num;
+    for (int b = 0; b <= BANDAS_PERF; b++) {
+        banda_perf_t banda = {nombres[b], -1, -1, 0, {0}, perf_muestras[b][PERF_RELOJ]};
+        if (b > 0) {
+            banda.desde = borde_perf(n, b - 1);
+            banda.hasta = b < BANDAS_PERF ? borde_perf(n, b) - 1 : n;
+            if (banda.desde > banda.hasta) continue;  // n chico: dos bordes en la misma profundidad
+            for (int d = banda.desde; d <= banda.hasta; d++) banda.nodos += estadisticas.nodos[d];
+        }
+        for (int e = 0; e < EVENTOS_PERF; e++)
+            banda.eventos[e] = muestras[e] ? perf_total[e] * perf_muestras[b][e] / muestras[e] : 0;
+        bandas[num++] = banda;
+    }
+    return num;
+}
+
+// Métricas de una banda por nodo; NAN donde falta el contador o no hay nodos.
+#define METRICAS_PERF 6
+const char *nombres_metricas_perf[METRICAS_PERF] = {"nodos_por_s", "ciclos_por_nodo", "instrucciones_por_nodo",
+                                                    "ipc", "fallos_salto_por_nodo", "fallos_l1_por_nodo"};
+
+void metricas_perf(const banda_perf_t *b, double m[METRICAS_PERF]) {
+    const double *ev = b->eventos;
+    bool hay[EVENTOS_PERF];
+    for (int e = 0; e < EVENTOS_PERF; e++) hay[e] = perf_disponible[e] && b->nodos > 0;
+    m[0] = hay[PERF_RELOJ] && ev[PERF_RELOJ] > 0 ? b->nodos * 1e9 / ev[PERF_RELOJ] : NAN;
+    m[1] = hay[PERF_CICLOS] ? ev[PERF_CICLOS] / b->nodos : NAN;
+    m[2] = hay[PERF_INSTRUCCIONES] ? ev[PERF_INSTRUCCIONES] / b->nodos : NAN;
+    m[3] = hay[PERF_CICLOS] && hay[PERF_INSTRUCCIONES] && ev[PERF_CICLOS] > 0
+         ? ev[PERF_INSTRUCCIONES] / ev[PERF_CICLOS] : NAN;
+    m[4] = hay[PERF_FALLOS_SALTO] ? ev[PERF_FALLOS_SALTO] / b->nodos : NAN;
+    m[5] = hay[PERF_FALLOS_L1] ? ev[PERF_FALLOS_L1] / b->nodos : NAN;
+}
+
+// Tabla de --perf en stdout: una fila por banda, con "-" donde el contador no está disponible.
+void imprimir_perf(int n) {
+    banda_perf_t bandas[BANDAS_PERF + 2];
+    int num = bandas_perf(n, bandas);
+    char faltan[128] = "";
+    for (int e = PERF_CICLOS; e < EVENTOS_PERF; e++) {
+        if (!perf_disponible[e]) snprintf(faltan + strlen(faltan), sizeof(faltan) - strlen(faltan), " %s", nombres_perf[e]);
+    }
+    printf("Contadores del procesador (motor %s, %d hilo(s))%s%s:\n", nombres_motor[motor],
+           motor == MOTOR_BITS ? hilos : 1, faltan[0] ? "; no disponibles en esta maquina:" : "", faltan);
+    printf("%-8s %-7s %14s %10s %9s %14s %12s %12s %6s %14s %12s\n", "banda", "niveles", "nodos", "tiempo_ms",
+           "muestras", "nodos/s", "ciclos/nodo", "instr/nodo", "IPC", "fallos_salto/n", "fallos_l1/n");
+    const int anchos[METRICAS_PERF] = {14, 12, 12, 6, 14, 12};
+    const int decimales[METRICAS_PERF] = {0, 1, 1, 2, 3, 3};
+    for (int k = 0; k < num; k++) {
+        double m[METRICAS_PERF];
+        char niveles[16] = "-", nodos[24] = "-";
+        metricas_perf(&bandas[k], m);
+        if (bandas[k].desde >= 0) snprintf(niveles, sizeof(niveles), "%d-%d", bandas[k].desde, bandas[k].hasta);
+        if (bandas[k].nodos > 0) snprintf(nodos, sizeof(nodos), "%.0f", bandas[k].nodos);
+        printf("%-8s %-7s %14s %10.1f %9llu", bandas[k].nombre, niveles, nodos, bandas[k].eventos[PERF_RELOJ] / 1e6,
+               bandas[k].muestras);
+        for (int j = 0; j < METRICAS_PERF; j++) {
+            if (isnan(m[j])) printf(" %*s", anchos[j], "-");
+            else printf(" %*.*f", anchos[j], decimales[j], m[j]);
+        }
+        printf("\n");
+    }
+}
+
+// Objeto "perf" del resumen JSON (null donde el contador no está disponible).
+void emitir_perf_json(int n) {
+    banda_perf_t bandas[BANDAS_PERF + 2];
+    int num = bandas_perf(n, bandas);
+    fprintf(stderr, ",\"perf\":{\"eventos\":{");
+    for (int e = 0; e < EVENTOS_PERF; e++)
+        fprintf(stderr, "%s\"%s\":%s", e ? "," : "", nombres_perf[e], perf_disponible[e] ? "true" : "false");
+    fprintf(stderr, "},\"periodos\":{");
+    for (int e = 0; e < EVENTOS_PERF; e++)
+        fprintf(stderr, "%s\"%s\":%llu", e ? "," : "", nombres_perf[e], periodos_perf[e]);
+    fprintf(stderr, "},\"bandas\":[");
+    for (int k = 0; k < num; k++) {
+        double m[METRICAS_PERF];
+        metricas_perf(&bandas[k], m);
+        fprintf(stderr, "%s{\"banda\":\"%s\",\"desde\":%d,\"hasta\":%d,\"nodos\":%.0f,\"muestras\":%llu", k ? "," : "",
+                bandas[k].nombre, bandas[k].desde, bandas[k].hasta, bandas[k].nodos, bandas[k].muestras);
+        for (int e = 0; e < EVENTOS_PERF; e++) {
+            if (!perf_disponible[e]) fprintf(stderr, ",\"%s\":null", nombres_perf[e]);
+            else fprintf(stderr, ",\"%s\":%.0f", nombres_perf[e], bandas[k].eventos[e]);
+        }
+        for (int j = 0; j < METRICAS_PERF; j++) {
+            if (isnan(m[j])) fprintf(stderr, ",\"%s\":null", nombres_metricas_perf[j]);
+            else fprintf(stderr, ",\"%s\":%.4f", nombres_metricas_perf[j], m[j]);
+        }
+        fprintf(stderr, "}");
+    }
+    fprintf(stderr, "]}");
+}
+
+void emitir_resumen(int n, unsigned long long soluciones, long long microsec) {
+    unsigned long long nodos = nodos_totales();
+
+    fprintf(stderr, "{\"tipo\":\"resumen\",\"n\":%d,\"motor\":\"%s\",\"hilos\":%d,\"simetria\":%s,\"anticipar\":%d,"
+            "\"nucleo\":\"%s\",\"completo\":%s,\"soluciones\":%llu,\"nodos\":%llu,\"tiempo_us\":%lld,\"nodos_por_s\":%.0f,"
+            "\"niveles\":[",
+            n, nombres_motor[motor], motor == MOTOR_BITS ? hilos : 1, simetria ? "true" : "false",
+            umbral_anticipacion < n ? umbral_anticipacion : 0,
+            motor == MOTOR_BITS && nucleo_fijo && nucleos[n] != NULL ? "fijo" : "generico",
+            tiempo_agotado ? "false" : "true", soluciones, nodos, microsec,
+            microsec > 0 ? (double)nodos * 1e6 / microsec : 0.0);
+    for (int d = 0; d <= n; d++) {
+        unsigned long long podados = estadisticas.rechazo_usado[d] + estadisticas.rechazo_fuera[d]
+                                   + estadisticas.rechazo_dif[d] + estadisticas.cortes_simetria[d]
+                                   + estadisticas.cortes_anticipacion[d] + estadisticas.cortes_grados[d];
+        fprintf(stderr, "%s{\"d\":%d,\"nodos\":%llu,\"expandidos\":%llu,\"sin_salida\":%llu,\"podados\":%llu,"
+                "\"rechazo_usado\":%llu,\"rechazo_fuera\":%llu,\"rechazo_dif\":%llu,\"cortes_simetria\":%llu,"
+                "\"cortes_anticipacion\":%llu,\"cortes_grados\":%llu}",
+                d ? "," : "", d, estadisticas.nodos[d], estadisticas.expandidos[d], estadisticas.sin_salida[d], podados,
+                estadisticas.rechazo_usado[d], estadisticas.rechazo_fuera[d], estadisticas.rechazo_dif[d],
+                estadisticas.cortes_simetria[d], estadisticas.cortes_anticipacion[d], estadisticas.cortes_grados[d]);
+    }
+    fprintf(stderr, "]");
+    if (memo_bytes > 0) {
+        fprintf(stderr, ",\"memo\":{\"bytes\":%llu,\"consultas\":%llu,\"aciertos\":%llu,\"tasa_aciertos\":%.4f,\"guardados\":%llu}",
+                (unsigned long long)(memo_total.num_cubetas * MEMO_VIAS * sizeof(entrada_memo_t)),
+                memo_total.consultas, memo_total.aciertos,
+                memo_total.consultas ? (double)memo_total.aciertos / memo_total.consultas : 0.0, memo_total.guardados);
+    }
+    if (tabla_hojas.k > 0) {
+        fprintf(stderr, ",\"hojas\":{\"k\":%d,\"estados\":%llu,\"bytes\":%llu,\"subarboles\":%llu,\"nodos_omitidos\":%.0f}",
+                tabla_hojas.k, (unsigned long long)tabla_hojas.ocupadas,
+                (unsigned long long)(tabla_hojas.capacidad * sizeof(entrada_memo_t)), subarboles_hojas, nodos_omitidos_hojas);
+    }
+    if (poda_grados > 0) {
+        unsigned long long cortes = 0;
+        for (int d = 0; d <= n; d++) cortes += estadisticas.cortes_grados[d];
+        fprintf(stderr, ",\"grados\":{\"k\":%d,\"cortes\":%llu,\"nodos_ahorrados\":%.0f}", poda_grados, cortes,
+                nodos_ahorrados_grados);
+    }
+    if (medir_perf) emitir_perf_json(n);
+    fprintf(stderr, "}\n");
+}
+
+// Cache de resultados (--cache)
+/*Archivo de texto con una línea por resultado:
+    GRACILES-CACHE 3
+    <n> <motor> <versión> <simetria> <anticipar> <memo> <hilos> <hojas> <grados> <completo> <soluciones> <nodos> <tiempo_us> <checkpoint> <suma>
+La clave es todo lo que cambia los nodos o el tiempo que se informan: n, motor, versión del motor,
+--simetria, el umbral de --anticipar, los MB de --memo, los hilos (cada uno tiene su parte de la
+tabla de --memo, y el tiempo depende de ellos), --hojas y el k de --grados. Las caches de versiones
+anteriores, con menos campos en la clave, se rechazan enteras. 'checkpoint' es '-' o el
+checkpoint de un resultado incompleto, desde el que la próxima ejecución con la misma clave sigue
+sola. 'suma' es un FNV-1a de los demás campos: una línea dañada o editada a mano se ignora.
+Se reescribe entera en <archivo>.tmp y se renombra, como los checkpoints.*/
+typedef struct {
+    int n, motor, version, simetria, anticipar, memo, hilos, hojas, grados, completo;
+    unsigned long long soluciones, nodos;
+    long long tiempo_us;
+    char checkpoint[1024];
+} entrada_cache_t;
+
+entrada_cache_t *entradas_cache = NULL;
+int num_cache = 0;
+
+// Suma de verificación de una entrada (todos los campos salvo la propia suma).
+uint64_t suma_cache(const entrada_cache_t *e) {
+    char texto[1200];
+    int largo = snprintf(texto, sizeof(texto), "%d %d %d %d %d %d %d %d %d %d %llu %llu %lld %s", e->n, e->motor,
+                         e->version, e->simetria, e->anticipar, e->memo, e->hilos, e->hojas, e->grados, e->completo,
+                         e->soluciones, e->nodos, e->tiempo_us, e->checkpoint);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < largo; i++) h = (h ^ (unsigned char)texto[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// Carga el archivo de cache (si no existe, la cache empieza vacía).
+void leer_cache(const char *archivo) {
+    FILE *f = fopen(archivo, "r");
+    if (f == NULL) return;
+    char linea[1400], nombre[32];
+    if (fgets(linea, sizeof(linea), f) == NULL || strncmp(linea, CABECERA_CACHE, strlen(CABECERA_CACHE)) != 0) {
+        printf("El archivo %s no es una cache de resultados; se ignora.\n", archivo);
+        fclose(f);
+        return;
+    }
+    int capacidad = 0;
+    while (fgets(linea, sizeof(linea), f) != NULL) {
+        entrada_cache_t e;
+        unsigned long long suma;
+        if (sscanf(linea, "%d %31s %d %d %d %d %d %d %d %d %llu %llu %lld %1023s %llx", &e.n, nombre, &e.version,
+                   &e.simetria, &e.anticipar, &e.memo, &e.hilos, &e.hojas, &e.grados, &e.completo, &e.soluciones,
+                   &e.nodos, &e.tiempo_us, e.checkpoint, &suma) != 15)
+            continue;
+        e.motor = -1;
+        for (int m = 0; m <= MOTOR_CARRILES; m++)
+            if (strcmp(nombre, nombres_motor[m]) == 0) e.motor = m;
+        if (e.motor < 0 || suma != suma_cache(&e)) {
+            fprintf(stderr, "Linea danada en la cache %s: %s", archivo, linea);
+            continue;
+        }
+        if (num_cache == capacidad) {
+            capacidad = capacidad ? 2 * capacidad : 64;
+            entradas_cache = realloc(entradas_cache, capacidad * sizeof(entrada_cache_t));
+        }
+        entradas_cache[num_cache++] = e;
+    }
+    fclose(f);
+}
+
+// Entrada de esta ejecución (misma clave) o NULL.
+entrada_cache_t *buscar_cache(const entrada_cache_t *clave) {
+    for (int i = 0; i < num_cache; i++) {
+        entrada_cache_t *e = &entradas_cache[i];
+        if (e->n == clave->n && e->motor == clave->motor && e->version == clave->version
+            && e->simetria == clave->simetria && e->anticipar == clave->anticipar && e->memo == clave->memo
+            && e->hilos == clave->hilos && e->hojas == clave->hojas && e->grados == clave->grados)
+            return e;
+    }
+    return NULL;
+}
+
+// Resultado completo del mismo n obtenido con otro motor u otra versión, para validar contra él.
+entrada_cache_t *buscar_referencia(const entrada_cache_t *clave) {
+    for (int i = 0; i < num_cache; i++) {
+        entrada_cache_t *e = &entradas_cache[i];
+        if (e->n == clave->n && e->completo && (e->motor != clave->motor || e->version != clave->version)) return e;
+    }
+    return NULL;
+}
+
+// Guarda (o reemplaza) una entrada y reescribe el archivo.
+bool guardar_cache(const char *archivo, const entrada_cache_t *nueva) {
+    entrada_cache_t *e = buscar_cache(nueva);
+    if (e == NULL) {
+        entradas_cache = realloc(entradas_cache, (num_cache + 1) * sizeof(entrada_cache_t));
+        e = &entradas_cache[num_cache++];
+    }
+    *e = *nueva;
+
+    char temporal[1100];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", archivo);
+    FILE *f = fopen(temporal, "w");
+    if (f == NULL) return false;
+    fprintf(f, "%s\n", CABECERA_CACHE);
+    for (int i = 0; i < num_cache; i++) {
+        e = &entradas_cache[i];
+        fprintf(f, "%d %s %d %d %d %d %d %d %d %d %llu %llu %lld %s %llx\n", e->n, nombres_motor[e->motor],
+                e->version, e->simetria, e->anticipar, e->memo, e->hilos, e->hojas, e->grados, e->completo,
+                e->soluciones, e->nodos, e->tiempo_us, e->checkpoint, (unsigned long long)suma_cache(e));
+    }
+    bool ok = (fclose(f) == 0);
+    return ok && rename(temporal, archivo) == 0;
+}
+
+// Clave de la ejecución en curso (los resultados se llenan después).
+entrada_cache_t clave_cache(int n) {
+    entrada_cache_t e;
+    memset(&e, 0, sizeof(e));
+    e.n = n;
+    e.motor = motor;
+    e.version = versiones_motor[motor];
+    e.simetria = simetria;
+    e.anticipar = umbral_anticipacion < n ? umbral_anticipacion : 0;
+    e.memo = (int)(memo_bytes >> 20);
+    e.hilos = motor == MOTOR_BITS ? hilos : 1;  // Los demás motores usan un solo hilo
+    e.hojas = hojas_k;
+    e.grados = poda_grados < n ? poda_grados : 0;  // Con k >= n no se poda ningún nivel
+    strcpy(e.checkpoint, "-");
+    return e;
+}
+
 // Función principal del programa
 int main(int argc, char *argv[]) {
-    // Verificar el número de argumentos
-    if (argc != 3) { //Asegura que el usuario proporciona el numero de argumentos correctos sino imprime <numero> <tiempo en minutos>
-        printf("Uso: %s <numero> <tiempo en minutos>\n", argv[0]);
+    // Los plazos del coordinador se miden con el reloj monotónico, como reloj_us (ver coordinar).
+    pthread_condattr_t atributos;
+    pthread_condattr_init(&atributos);
+    pthread_condattr_setclock(&atributos, CLOCK_MONOTONIC);
+    pthread_cond_init(&cambio_hilos, &atributos);
+    pthread_condattr_destroy(&atributos);
+
+    // Separar los argumentos posicionales de las opciones (las que empiezan con "--")
+    char *posicionales[2];
+    int num_posicionales = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--holgura") == 0 && i + 1 < argc) {
+            holgura_us = atoll(argv[++i]) * 1000LL;  // La holgura se da en milisegundos
+            if (holgura_us < 1000) holgura_us = 1000;
+        } else if (strcmp(argv[i], "--motor") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "clasico") == 0) motor = MOTOR_CLASICO;
+            else if (strcmp(argv[i], "bits") == 0) motor = MOTOR_BITS;
+            else if (strcmp(argv[i], "iterativo") == 0) motor = MOTOR_ITERATIVO;
+            else if (strcmp(argv[i], "mitad") == 0) motor = MOTOR_MITAD;
+            else if (strcmp(argv[i], "diferencias") == 0) motor = MOTOR_DIFERENCIAS;
+            else if (strcmp(argv[i], "carriles") == 0) motor = MOTOR_CARRILES;
+            else { num_posicionales = -1; break; }
+        } else if (strcmp(argv[i], "--hilos") == 0 && i + 1 < argc) {
+            hilos = atoi(argv[++i]);
+            if (hilos < 1) hilos = 1;
+            if (hilos > MAX_HILOS) hilos = MAX_HILOS;
+        } else if (strcmp(argv[i], "--profundidad") == 0 && i + 1 < argc) {
+            profundidad_division = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--simetria") == 0) {
+            simetria = true;
+        } else if (strcmp(argv[i], "--comprobar") == 0) {
+            comprobar = true;
+        } else if (strcmp(argv[i], "--estimate") == 0 && i + 1 < argc) {
+            sondeos = atoll(argv[++i]);
+            if (sondeos < 1) sondeos = 1;
+        } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            muestras_pedidas = atoll(argv[++i]);
+            if (muestras_pedidas < 1) muestras_pedidas = 1;
+        } else if (strcmp(argv[i], "--unrank") == 0 && i + 1 < argc) {
+            indice_pedido = strtoull(argv[++i], NULL, 10);
+            pedir_indice = true;
+        } else if (strcmp(argv[i], "--semilla") == 0 && i + 1 < argc) {
+            semilla_muestras = strtoull(argv[++i], NULL, 10) | 1;  // xorshift no puede partir de 0
+            semilla_dada = true;
+        } else if (strcmp(argv[i], "--listar") == 0) {
+            listar = true;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            archivo_checkpoint = argv[++i];
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            archivo_reanudar = argv[++i];
+        } else if (strcmp(argv[i], "--intervalo") == 0 && i + 1 < argc) {
+            intervalo_checkpoint_us = atoll(argv[++i]) * 1000000LL;  // El intervalo se da en segundos
+            if (intervalo_checkpoint_us < 1000000LL) intervalo_checkpoint_us = 1000000LL;
+        } else if (strcmp(argv[i], "--progreso") == 0 && i + 1 < argc) {
+            intervalo_progreso_us = atoll(argv[++i]) * 1000000LL;  // En segundos; 0 desactiva el progreso
+            if (intervalo_progreso_us < 0) intervalo_progreso_us = 0;
+        } else if (strcmp(argv[i], "--anticipar") == 0 && i + 1 < argc) {
+            umbral_anticipacion = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mem_mitad") == 0 && i + 1 < argc) {
+            mem_mitad_bytes = atoll(argv[++i]) * 1024LL * 1024LL;  // En MB
+            if (mem_mitad_bytes < 1024LL * 1024LL) mem_mitad_bytes = 1024LL * 1024LL;
+        } else if (strcmp(argv[i], "--memo") == 0 && i + 1 < argc) {
+            memo_bytes = atoll(argv[++i]) * 1024LL * 1024LL;  // La memoria se da en MB
+            if (memo_bytes < 0) memo_bytes = 0;
+        } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+            isa_carriles = argv[++i];
+            if (strcmp(isa_carriles, "avx512") != 0 && strcmp(isa_carriles, "avx2") != 0
+                && strcmp(isa_carriles, "generico") != 0) {
+                num_posicionales = -1;
+                break;
+            }
+        } else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            archivo_emit = argv[++i];
+        } else if (strcmp(argv[i], "--emit_delta") == 0) {
+            salida_delta = true;
+        } else if (strcmp(argv[i], "--hojas") == 0 && i + 1 < argc) {
+            hojas_k = atoi(argv[++i]);
+            if (hojas_k < 0) hojas_k = 0;
+        } else if (strcmp(argv[i], "--grados") == 0 && i + 1 < argc) {
+            poda_grados = atoi(argv[++i]);
+            if (poda_grados < 0) poda_grados = 0;
+        } else if (strcmp(argv[i], "--nucleo") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fijo") == 0) nucleo_fijo = true;
+            else if (strcmp(argv[i], "generico") == 0) nucleo_fijo = false;
+            else { num_posicionales = -1; break; }
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            medir_perf = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            archivo_cache = argv[++i];
+        } else if (strcmp(argv[i], "--range") == 0 && i + 2 < argc) {
+            rango_desde = atoi(argv[++i]);
+            rango_hasta = atoi(argv[++i]);
+            if (rango_desde < 1 || rango_hasta < rango_desde || rango_hasta > MAX_N) {
+                num_posicionales = -1;
+                break;
+            }
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%d/%d", &shard, &num_shards) != 2 || num_shards < 1
+                || shard < 0 || shard >= num_shards) {
+                num_posicionales = -1;
+                break;
+            }
+        } else if (strncmp(argv[i], "--", 2) != 0 && num_posicionales < 2) {
+            posicionales[num_posicionales++] = argv[i];
+        } else {
+            num_posicionales = -1;  // Opción desconocida o argumentos de más
+            break;
+        }
+    }
+
+    // Verificar el número de argumentos (con --range el único posicional es el tiempo)
+    if (num_posicionales != (rango_hasta > 0 ? 1 : 2)) { //Asegura que el usuario proporciona el numero de argumentos correctos sino imprime <numero> <tiempo en minutos>
+        printf("Uso: %s <numero> <tiempo en minutos> [--holgura <ms>]\n"
+               "  o: %s --range <desde> <hasta> <tiempo en minutos> [opciones]\n"
+               "       [--motor clasico|bits|iterativo|mitad|diferencias|carriles]\n"
+               "       [--isa avx512|avx2|generico] [--hilos <h>] [--profundidad <d>]\n"
+               "       [--simetria] [--comprobar] [--listar]\n"
+               "       [--checkpoint <archivo>] [--intervalo <s>] [--resume <archivo>] [--shard <i>/<N>]\n"
+               "       [--progreso <s>] [--memo <MB>] [--anticipar <d>] [--estimate <sondeos>]\n"
+               "       [--mem_mitad <MB>] [--hojas <k>] [--emit <archivo>] [--emit_delta] [--cache <archivo>]\n"
+               "       [--nucleo fijo|generico] [--grados <k>] [--perf]\n"
+               "       [--sample <K> [--semilla <s>] | --unrank <i>]\n",
+               argv[0], argv[0]);
         return 1;
     }
 
     // Leer valores desde la línea de comandos
-    int n = atoi(argv[1]);  // Convertir el primer argumento a entero
-    int tiempo = atoi(argv[2]);  // Convertir el segundo argumento a entero
+    int n = rango_hasta > 0 ? rango_hasta : atoi(posicionales[0]);  // Convertir el primer argumento a entero
+    int tiempo = atoi(posicionales[rango_hasta > 0 ? 0 : 1]);  // Convertir el segundo argumento a entero
+    if (rango_hasta > 0 && (archivo_checkpoint || archivo_reanudar || num_shards > 1 || sondeos > 0 || hojas_k > 0
+                            || archivo_emit || comprobar || listar || archivo_cache)) {
+        printf("--range no se puede usar con --checkpoint, --resume, --shard, --estimate, --hojas, --emit,\n"
+               "--comprobar, --listar ni --cache.\n");
+        return 1;
+    }
+    if (medir_perf && (rango_hasta > 0 || sondeos > 0)) {
+        printf("--perf mide la busqueda de un solo n: no se puede usar con --range ni --estimate.\n");
+        return 1;
+    }
+    if ((muestras_pedidas > 0 || pedir_indice)
+        && ((muestras_pedidas > 0 && pedir_indice) || rango_hasta > 0 || sondeos > 0 || simetria || archivo_checkpoint
+            || archivo_reanudar || num_shards > 1 || archivo_emit || archivo_cache || hojas_k > 0 || poda_grados > 0
+            || comprobar || listar || medir_perf || motor != MOTOR_BITS)) {
+        printf("--sample y --unrank no se combinan entre si ni con --range, --estimate, --simetria, --checkpoint,\n"
+               "--resume, --shard, --emit, --cache, --hojas, --grados, --comprobar, --listar ni --perf, y usan el motor de bits.\n");
+        return 1;
+    }
+    if (archivo_cache != NULL && (num_shards > 1 || sondeos > 0)) {
+        printf("--cache guarda conteos completos de un n: no se puede usar con --shard ni --estimate.\n");
+        return 1;
+    }
+
+    diagnosticos = (rango_hasta > 0 || listar) ? stderr : stdout;  // Que el CSV y las listas queden limpios
 
     // Validar el rango de entrada
     if (n < 0 || n > 50) {
         printf("Numero fuera de rango. Debe estar entre 0 y 50.\n");
         return 1;
     }
+    if ((simetria || num_shards > 1 || memo_bytes > 0 || sondeos > 0 || hojas_k > 0 || archivo_emit
+         || poda_grados > 0) && motor != MOTOR_BITS) {
+        printf("--simetria, --shard, --memo, --estimate, --hojas, --emit y --grados solo estan disponibles con\n"
+               "--motor bits.\n");
+        return 1;
+    }
+    if ((archivo_checkpoint || archivo_reanudar) && motor != MOTOR_BITS && motor != MOTOR_ITERATIVO) {
+        printf("--checkpoint y --resume solo estan disponibles con --motor bits e iterativo.\n");
+        return 1;
+    }
+    if (archivo_emit != NULL && (memo_bytes > 0 || hojas_k > 0 || archivo_checkpoint || archivo_reanudar || n < 2)) {
+        // La tabla y el núcleo cuentan subárboles sin recorrerlos, y al reanudar faltarían las soluciones ya contadas.
+        printf("--emit necesita n >= 2 y no se puede usar con --memo, --hojas, --checkpoint ni --resume.\n");
+        return 1;
+    }
+    if (salida_delta && archivo_emit == NULL) {
+        printf("--emit_delta solo tiene sentido con --emit.\n");
+        return 1;
+    }
+    if (salida_delta && simetria) {
+        // Las órbitas se escriben seguidas y no comparten prefijo: el delta agranda el archivo.
+        printf("--emit_delta no se usa con --simetria (el archivo saldria mas grande); se escribe sin delta.\n");
+        salida_delta = false;
+    }
+    if (listar && motor != MOTOR_ITERATIVO) {
+        printf("--listar solo esta disponible con --motor iterativo.\n");
+        return 1;
+    }
+    if (num_shards > 1 && n < 2) {
+        printf("--shard necesita n >= 2.\n");
+        return 1;
+    }
+    if (memo_bytes > 0 || hojas_k > 0) nucleo_fijo = false;  // Los núcleos especializados no tienen tabla
+    if (rango_hasta == 0) umbral_anticipacion = resolver_umbral(umbral_anticipacion, n);  // Con --range, uno por n
+    if (comprobar && n > 12) {
+        printf("--comprobar usa fuerza bruta y solo acepta n <= 12.\n");
+        return 1;
+    }
 
     // Configuración del contador de tiempo
-    QueryPerformanceFrequency(&frecuencia);
-    QueryPerformanceCounter(&comienzo);
+    comienzo = reloj_us();
+    ultimo_progreso = comienzo;
+    iniciar_presupuesto(&presupuesto_global);
     tiempo_limite = tiempo * 60 * 1000000LL;  // Convertir minutos a microsegundos
 
+    // Con --range se cuentan todos los n del barrido y se escribe la tabla en vez del resultado de uno.
+    if (rango_hasta > 0) {
+        fila_rango_t filas[MAX_N + 1];
+        memset(filas, 0, sizeof(filas));
+        if (motor == MOTOR_BITS) contar_rango_bits(rango_desde, rango_hasta, filas);
+        else contar_rango_secuencial(rango_desde, rango_hasta, filas);
+        emitir_rango(rango_desde, rango_hasta, filas, reloj_us() - comienzo);
+        return 0;
+    }
+
+    // Con --estimate no se cuenta: se predice el tamaño del árbol y el tiempo, y se termina.
+    if (sondeos > 0) {
+        if (n < 2) {
+            printf("--estimate necesita n >= 2.\n");
+            return 1;
+        }
+        estimar(n, tiempo);
+        return 0;
+    }
+
+    // Con --sample o --unrank se cuentan los subárboles una vez y se escriben las permutaciones pedidas.
+    if (muestras_pedidas > 0 || pedir_indice) {
+        if (n < 1) {
+            printf("--sample y --unrank necesitan n >= 1.\n");
+            return 1;
+        }
+        return consultar_orden(n);
+    }
+
+
+    // Con --cache, un resultado completo con la misma clave se devuelve sin buscar, y uno incompleto
+    // que dejó checkpoint se continúa desde ahí.
+    entrada_cache_t clave;
+    static char checkpoint_cache[1024];  // Copia: las entradas se mueven al guardar la cache
+    if (archivo_cache != NULL) {
+        leer_cache(archivo_cache);
+        clave = clave_cache(n);
+        entrada_cache_t *e = buscar_cache(&clave);
+        if (e != NULL && e->completo && archivo_emit == NULL && !listar && !comprobar) {
+            printf("El numero de permutaciones graciles de %d es: %llu\n", n, e->soluciones);
+            printf("Resultado de la cache %s (motor %s v%d: %llu nodos, %lld [us] al calcularlo).\n", archivo_cache,
+                   nombres_motor[e->motor], e->version, e->nodos, e->tiempo_us);
+            fprintf(stderr, "{\"tipo\":\"resumen\",\"n\":%d,\"motor\":\"%s\",\"simetria\":%s,\"anticipar\":%d,"
+                    "\"completo\":true,\"cache\":true,\"soluciones\":%llu,\"nodos\":%llu,\"tiempo_us\":%lld,"
+                    "\"nodos_por_s\":%.0f,\"niveles\":[]}\n", n, nombres_motor[e->motor], e->simetria ? "true" : "false",
+                    e->anticipar, e->soluciones, e->nodos, e->tiempo_us,
+                    e->tiempo_us > 0 ? (double)e->nodos * 1e6 / e->tiempo_us : 0.0);
+            return 0;
+        }
+        if (e != NULL && !e->completo && strcmp(e->checkpoint, "-") != 0 && archivo_reanudar == NULL
+            && archivo_emit == NULL) {
+            FILE *f = fopen(e->checkpoint, "r");
+            if (f != NULL) {
+                fclose(f);
+                strcpy(checkpoint_cache, e->checkpoint);
+                archivo_reanudar = checkpoint_cache;
+                if (archivo_checkpoint == NULL) archivo_checkpoint = checkpoint_cache;
+                printf("Se continua desde el checkpoint %s anotado en la cache.\n", checkpoint_cache);
+            }
+        }
+    }
 
     // Calcular el número total de permutaciones posibles (factorial de n-1)
     /*Ejemplo con n = 4 (restringiendo el primer elemento)
@@ -190,22 +3495,100 @@ int main(int argc, char *argv[]) {
     unsigned long long duplica la capacidad de valores positivos porque no usa un bit para el signo.
     */
 
+    // Con --perf, el hilo principal abre sus contadores: muestran qué eventos hay en esta máquina y
+    // miden los motores de un hilo (los trabajadores del motor de bits abren los suyos).
+    double perf_antes[EVENTOS_PERF], perf_despues[EVENTOS_PERF];
+    if (medir_perf) {
+        if (!perf_abrir(&perf_principal)) {
+            printf("--perf necesita perf_event_open (Linux) y no se pudo abrir ni el reloj del hilo.\n");
+            return 1;
+        }
+        for (int e = 0; e < EVENTOS_PERF; e++) perf_disponible[e] = perf_principal.descriptores[e] >= 0;
+        perf_leer(&perf_principal, perf_antes);
+    }
+
     // Ejecutar el conteo de permutaciones gráciles
-    int resultado = contar_permutaciones_graciles(n);
+    unsigned long long resultado = contar_permutaciones_graciles(n);
+    if (medir_perf) {
+        perf_leer(&perf_principal, perf_despues);
+        perf_acumular(perf_antes, perf_despues, perf_total);
+        perf_cerrar(&perf_principal);
+        for (int e = 0; e < EVENTOS_PERF; e++) perf_muestras[0][e] += perf_principal.muestras[0][e];
+    }
 
     // Medir el tiempo de ejecución total
-    LARGE_INTEGER final;
-    QueryPerformanceCounter(&final);
-    long long microsec = (final.QuadPart - comienzo.QuadPart) * 1000000LL / frecuencia.QuadPart;
+    long long microsec = reloj_us() - comienzo;
 
     // Mostrar los resultados
     if (tiempo_agotado) {
-        printf("Tiempo agotado. Se encontraron %d permutaciones graciles antes de detenerse.\n", contador);
+        printf("Tiempo agotado. Se encontraron %llu permutaciones graciles antes de detenerse.\n", contador);
     } else {
-        printf("El numero de permutaciones graciles de %d es: %d\n", n, resultado);
+        printf("El numero de permutaciones graciles de %d es: %llu\n", n, resultado);
+    }
+    printf("Se generaron %d grupos de %llu combinaciones cada uno.\n", n, total_permutaciones);
+    emitir_resumen(n, resultado, microsec);  // Reemplaza a la antigua línea "Tiempo: ... [us]"
+    if (num_shards > 1) {
+        // Registro que lee fusionar_shards.py (una sola línea, campos clave=valor).
+        printf("SHARD %d/%d n=%d simetria=%d profundidad=%d prefijos=%lld prefijos_totales=%lld "
+               "soluciones=%llu nodos=%llu tiempo_us=%lld completo=%d\n",
+               shard, num_shards, n, simetria ? 1 : 0, profundidad_division, prefijos_propios, prefijos_totales,
+               resultado, nodos_visitados, tiempo_previo_us + microsec, tiempo_agotado ? 0 : 1);
+    }
+    if (memo_bytes > 0) {
+        printf("Tabla de transposicion: %.1f MB, %llu consultas, %.1f%% de aciertos.\n",
+               memo_total.num_cubetas * MEMO_VIAS * sizeof(entrada_memo_t) / (1024.0 * 1024.0), memo_total.consultas,
+               memo_total.consultas ? 100.0 * memo_total.aciertos / memo_total.consultas : 0.0);
+    }
+    if (archivo_emit != NULL) {
+        printf("Soluciones escritas en %s: %llu registros, %.1f MB (%.2f bytes por registro).\n", archivo_emit,
+               registros_emitidos, bytes_emitidos / (1024.0 * 1024.0),
+               registros_emitidos ? (double)bytes_emitidos / registros_emitidos : 0.0);
+    }
+    if (tabla_hojas.k > 0) {
+        double omitidos = nodos_omitidos_hojas / (nodos_visitados + nodos_omitidos_hojas);
+        printf("Nucleo de hojas (k=%d): tabla de %llu estados (%.1f MB, %.1f ms), %llu subarboles resueltos,\n"
+               "~%.1f%% de los nodos omitidos.\n", tabla_hojas.k, (unsigned long long)tabla_hojas.ocupadas,
+               tabla_hojas.capacidad * sizeof(entrada_memo_t) / (1024.0 * 1024.0), tabla_hojas.tiempo_us / 1000.0,
+               subarboles_hojas, 100.0 * omitidos);
+    }
+    if (poda_grados > 0) {
+        unsigned long long cortes = 0;
+        for (int d = 0; d <= n; d++) cortes += estadisticas.cortes_grados[d];
+        printf("Poda por grados (cada %d niveles): %llu cortes, ~%.0f nodos ahorrados (%.1f%% del arbol sin ella).\n",
+               poda_grados, cortes, nodos_ahorrados_grados,
+               100.0 * nodos_ahorrados_grados / (nodos_visitados + nodos_ahorrados_grados));
+    }
+    if (medir_perf) imprimir_perf(n);
+    if (archivo_checkpoint != NULL) {
+        printf("Tiempo acumulado: %lld [us]\n", tiempo_previo_us + microsec);
+        if (tiempo_agotado)
+            printf("Quedan %lld subarboles pendientes guardados en %s.\n", tareas_en_frontera, archivo_checkpoint);
+    }
+
+    // Comparación con la fuerza bruta (fuera del tiempo medido).
+    if (comprobar && !tiempo_agotado) {
+        unsigned long long esperado = contar_fuerza_bruta(n);
+        printf("Fuerza bruta: %llu (%s)\n", esperado, esperado == resultado ? "coincide" : "NO coincide");
+        if (esperado != resultado) return 2;
+    }
+
+    // Anotar el resultado en la cache, validándolo antes contra el de otro motor o de otra versión.
+    if (archivo_cache != NULL) {
+        clave.completo = !tiempo_agotado;
+        clave.soluciones = resultado;
+        clave.nodos = nodos_totales();
+        clave.tiempo_us = tiempo_previo_us + microsec;
+        if (tiempo_agotado && archivo_checkpoint != NULL && strlen(archivo_checkpoint) < sizeof(clave.checkpoint)
+            && strpbrk(archivo_checkpoint, " \t\n") == NULL)  // El formato separa los campos con espacios
+            strcpy(clave.checkpoint, archivo_checkpoint);
+        entrada_cache_t *ref = clave.completo ? buscar_referencia(&clave) : NULL;
+        if (ref != NULL) {
+            printf("Cache: %s con el motor %s v%d (%llu).\n", ref->soluciones == resultado ? "coincide" : "NO coincide",
+                   nombres_motor[ref->motor], ref->version, ref->soluciones);
+            if (ref->soluciones != resultado) return 2;  // No se guarda un resultado que contradice a la cache
+        }
+        if (!guardar_cache(archivo_cache, &clave)) printf("No se pudo escribir la cache %s.\n", archivo_cache);
     }
-    printf("Se generaron %llu grupos de %llu combinaciones cada uno.\n", n, total_permutaciones);
-    printf("Tiempo: %lld [us]\n", microsec);
 
     return 0;
 }
@@ -5,6 +5,7 @@
 #include "hardware/pwm.h"
 #include "hardware/gpio.h"
 #include "hardware/clocks.h"
+#include "hardware/sync.h"
 
 #define IN1 1
 #define IN2 2
@@ -12,12 +13,30 @@
 #define SENSOR_PIN 10
 #define PULSOS_POR_REV 20
 #define MAX_MUESTRAS 5000
-
-// Buffers para captura
-uint32_t timestamp[MAX_MUESTRAS];
+#define MAX_ESCALONES 256
+#define PERIODO_POR_DEFECTO_US 4000
+#define PERIODO_MIN_US 100
+#define PERIODO_MAX_US 1000000
+#define DURACION_PWM_US 15000000 // Captura del comando PWM
+
+// Buffers para captura (los llena el timer de muestreo). La muestra k va en k % MAX_MUESTRAS:
+// en vivo son un anillo que se vacia mientras se imprime, sin limite de duracion; sin imprimir
+// en vivo caben las primeras MAX_MUESTRAS.
+uint32_t timestamp[MAX_MUESTRAS]; // us desde la primera muestra
 int pwmBuffer[MAX_MUESTRAS];
 float rpmBuffer[MAX_MUESTRAS];
-int idx = 0;
+volatile uint32_t idx = 0; // Muestras guardadas desde el inicio de la captura
+volatile uint32_t impresas = 0; // Muestras ya impresas (en vivo); las que esperan son idx - impresas
+
+// Muestreo por timer: cada periodo_muestreo_us el timer aplica el escalon de PWM que toca y guarda una muestra
+uint32_t periodo_muestreo_us = PERIODO_POR_DEFECTO_US;
+repeating_timer_t timer_muestreo;
+int escalones[MAX_ESCALONES]; // PWM de cada escalon de la secuencia
+int num_escalones = 0;
+uint32_t muestras_por_escalon = 1;
+volatile uint32_t muestra_actual = 0; // Ticks del timer desde el inicio de la captura
+volatile uint32_t muestras_perdidas = 0; // Muestras que no cupieron en los buffers
+uint32_t inicio_captura = 0;
 
 // PWM
 uint32_t pwm_wrap = 0;
@@ -25,7 +44,7 @@ int pwm_actual = 0;
 
 // Modo de medición
 int modo_medicion = 0; // 0=polling, 1=irq, 2=combinado
-bool capturando = false;
+volatile bool capturando = false;
 bool sistema_activo = true;
 
 // Variables para IRQ
@@ -110,89 +129,103 @@ void gpio_callback(uint gpio, uint32_t events) {
     }
 }
 
-void captura_por_15s(int pwm_deseado) {
+// Callback del timer: en los bordes de escalon cambia el PWM y luego toma la muestra.
+// Con retardo negativo el periodo se cuenta entre inicios de callback, asi que no se acumula desfase.
+bool muestrear(repeating_timer_t *t) {
+    (void)t;  // El timer es siempre timer_muestreo
+    uint32_t k = muestra_actual++;
+    uint32_t escalon = k / muestras_por_escalon;
+    if (escalon >= (uint32_t)num_escalones) {
+        set_pwm_duty(0); // fin de la secuencia: apaga motor y detiene el timer
+        capturando = false;
+        return false;
+    }
+    uint32_t ahora = time_us_32();
+    if (k == 0) inicio_captura = ahora;
+    if (k % muestras_por_escalon == 0) set_pwm_duty(escalones[escalon]);
+
+    float rpm = medir_rpm();
+    if (idx - impresas < MAX_MUESTRAS) {
+        uint32_t i = idx % MAX_MUESTRAS;
+        timestamp[i] = ahora - inicio_captura;
+        pwmBuffer[i] = pwm_actual;
+        rpmBuffer[i] = rpm;
+        idx++;
+    } else {
+        muestras_perdidas++;
+    }
+    return true;
+}
+
+void imprimir_muestra(uint32_t k) {
+    uint32_t i = k % MAX_MUESTRAS;
+    printf("%lu.%03lu,%d,%.2f\n", (unsigned long)(timestamp[i] / 1000), (unsigned long)(timestamp[i] % 1000),
+           pwmBuffer[i], rpmBuffer[i]);
+}
+
+// Recorre escalones[] (cada uno dura_us) muestreando con el timer, mientras el nucleo duerme.
+// Con en_vivo imprime la cabecera y cada muestra apenas se guarda; imprimir ya no corre los
+// instantes de muestreo. Cada escalon son las muestras enteras mas cercanas a dura_us.
+void capturar(uint32_t dura_us, bool en_vivo) {
     idx = 0;
+    impresas = 0;
+    muestra_actual = 0;
+    muestras_perdidas = 0;
     pulse_count = 0;
-    last_calc_time = to_ms_since_boot(get_absolute_time());
-
-    set_pwm_duty(pwm_deseado);
-    absolute_time_t inicio = get_absolute_time();
-    uint32_t tiempo_muestra = time_us_32();
+    muestras_por_escalon = (dura_us + periodo_muestreo_us / 2) / periodo_muestreo_us;
+    if (muestras_por_escalon == 0) muestras_por_escalon = 1;
+    if (muestras_por_escalon * periodo_muestreo_us != dura_us)
+        printf("Cada escalon dura %lu us (%lu muestras de %lu us), no %lu us.\n",
+               (unsigned long)(muestras_por_escalon * periodo_muestreo_us), (unsigned long)muestras_por_escalon,
+               (unsigned long)periodo_muestreo_us, (unsigned long)dura_us);
+    if (en_vivo) printf("timestamp_ms,pwm_percent,rpm\n");
+    capturando = true;
 
-    while (to_ms_since_boot(get_absolute_time()) - to_ms_since_boot(inicio) < 15000 && idx < MAX_MUESTRAS) {
-        uint32_t ahora = time_us_32();
+    if (!add_repeating_timer_us(-(int64_t)periodo_muestreo_us, muestrear, NULL, &timer_muestreo)) {
+        capturando = false;
+        printf("No se pudo iniciar el timer de muestreo.\n");
+        return;
+    }
 
-        if ((ahora - tiempo_muestra) >= 4000) { // cada 4 ms
-            float rpm = medir_rpm();
-            uint32_t t_ms = to_ms_since_boot(get_absolute_time());
-            timestamp[idx] = t_ms - to_ms_since_boot(inicio);
-            pwmBuffer[idx] = pwm_deseado;
-            rpmBuffer[idx] = rpm;
-            idx++;
-            tiempo_muestra = ahora;
-        }
+    while (true) {
+        while (en_vivo && impresas < idx) imprimir_muestra(impresas++);
+        // Se revisa con las interrupciones enmascaradas para no dormir despues del ultimo tick
+        uint32_t estado = save_and_disable_interrupts();
+        bool fin = !capturando;
+        if (!fin && !(en_vivo && impresas < idx)) __wfi();
+        restore_interrupts(estado);
+        if (fin) break;
     }
+    while (en_vivo && impresas < idx) imprimir_muestra(impresas++);
+
+    if (muestras_perdidas > 0 && en_vivo)
+        printf("La salida no alcanzo al muestreo: se descartaron %lu muestras.\n", (unsigned long)muestras_perdidas);
+    else if (muestras_perdidas > 0)
+        printf("Buffer lleno: se descartaron %lu muestras.\n", (unsigned long)muestras_perdidas);
+}
 
-    set_pwm_duty(0); // apaga motor
+void captura_por_15s(int pwm_deseado) {
+    escalones[0] = pwm_deseado;
+    num_escalones = 1;
+    capturar(DURACION_PWM_US, false);
 
     printf("timestamp_ms,pwm_percent,rpm\n");
-    for (int i = 0; i < idx; i++) {
-        printf("%lu,%d,%.2f\n", timestamp[i], pwmBuffer[i], rpmBuffer[i]);
+    for (uint32_t i = 0; i < idx; i++) {
+        imprimir_muestra(i);
     }
     printf("Captura finalizada.\n");
 }
 
 void captura_reaccion(int paso_pwm) {
-    const int tiempo_entre_pasos = 2000;
-    idx = 0;
-    capturando = true;
-
-    int pwm = 0;
-    absolute_time_t inicio = get_absolute_time();
-    printf("timestamp_ms,pwm_percent,rpm\n");
-
-    for (int i = 0; pwm <= 100; i++, pwm = i * paso_pwm) {
-        if (pwm > 100) break;
-        set_pwm_duty(pwm);
-        uint32_t t_inicio = to_ms_since_boot(get_absolute_time());
-
-        while (to_ms_since_boot(get_absolute_time()) - t_inicio < tiempo_entre_pasos) {
-            uint32_t ahora = time_us_32();
-            static uint32_t t_muestra = 0;
-            if (ahora - t_muestra >= 4000 && idx < MAX_MUESTRAS) {
-                float rpm = medir_rpm();
-                timestamp[idx] = to_ms_since_boot(get_absolute_time()) - to_ms_since_boot(inicio);
-                pwmBuffer[idx] = pwm;
-                rpmBuffer[idx] = rpm;
-                printf("%lu,%d,%.2f\n", timestamp[idx], pwmBuffer[idx], rpmBuffer[idx]);
-                idx++;
-                t_muestra = ahora;
-            }
-        }
-    }
-
-    for (int i = 100 - paso_pwm; i >= 0; i -= paso_pwm) {
-        set_pwm_duty(i);
-        uint32_t t_inicio = to_ms_since_boot(get_absolute_time());
-
-        while (to_ms_since_boot(get_absolute_time()) - t_inicio < tiempo_entre_pasos) {
-            uint32_t ahora = time_us_32();
-            static uint32_t t_muestra = 0;
-            if (ahora - t_muestra >= 4000 && idx < MAX_MUESTRAS) {
-                float rpm = medir_rpm();
-                timestamp[idx] = to_ms_since_boot(get_absolute_time()) - to_ms_since_boot(inicio);
-                pwmBuffer[idx] = i;
-                rpmBuffer[idx] = rpm;
-                printf("%lu,%d,%.2f\n", timestamp[idx], pwmBuffer[idx], rpmBuffer[idx]);
-                idx++;
-                t_muestra = ahora;
-            }
-        }
-    }
-
-    set_pwm_duty(0); // apagar motor al final
+    const uint32_t tiempo_entre_pasos_us = 2000000;
+    num_escalones = 0;
+    for (int pwm = 0; pwm <= 100 && num_escalones < MAX_ESCALONES; pwm += paso_pwm)
+        escalones[num_escalones++] = pwm;
+    for (int pwm = 100 - paso_pwm; pwm >= 0 && num_escalones < MAX_ESCALONES; pwm -= paso_pwm)
+        escalones[num_escalones++] = pwm;
+
+    capturar(tiempo_entre_pasos_us, true);
     printf("Secuencia completada.\n");
-    capturando = false;
 }
 
 void modo_interactivo() {
@@ -215,6 +248,18 @@ void modo_interactivo() {
                     printf("Valor fuera de rango.\n");
                 }
             }
+            else if (strncmp(comando, "PERIODO", 7) == 0) {
+                int us = atoi(&comando[8]);
+                if (us >= PERIODO_MIN_US && us <= PERIODO_MAX_US) {
+                    periodo_muestreo_us = us;
+                    printf("Periodo de muestreo: %d us\n", us);
+                    if (DURACION_PWM_US / us > MAX_MUESTRAS) // START imprime en vivo y no tiene este limite
+                        printf("PWM guardara solo los primeros %.2f s de los %d s (%d muestras).\n",
+                               MAX_MUESTRAS * (us / 1e6), DURACION_PWM_US / 1000000, MAX_MUESTRAS);
+                } else {
+                    printf("Periodo fuera de rango (%d a %d us).\n", PERIODO_MIN_US, PERIODO_MAX_US);
+                }
+            }
             else if (strncmp(comando, "STOP", 4) == 0) {
                 set_pwm_duty(0);
                 sistema_activo = false;
@@ -244,7 +289,7 @@ int main() {
     if (modo_medicion < 0 || modo_medicion > 2) modo_medicion = 0;
     printf("Modo seleccionado: %d\n", modo_medicion);
 
-    printf("Comandos disponibles:\nSTART <paso PWM>\nPWM <valor PWM>\nSTOP\n");
+    printf("Comandos disponibles:\nSTART <paso PWM>\nPWM <valor PWM>\nPERIODO <us>\nSTOP\n");
 
     modo_interactivo();
 
@@ -0,0 +1,19 @@
+// Sustituto de hardware/clocks.h: todos los relojes van a la frecuencia por defecto del RP2040.
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+#include "pico.h"
+
+#define SYS_CLK_HZ 125000000u
+
+enum clock_index {
+    clk_gpout0 = 0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc,
+    CLK_COUNT
+};
+
+static inline uint32_t clock_get_hz(int clk_index) {
+    (void)clk_index;
+    return SYS_CLK_HZ;
+}
+
+#endif
@@ -0,0 +1,12 @@
+// Sustituto de hardware/irq.h: las interrupciones del simulador siempre están habilitadas.
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include "pico.h"
+
+static inline void irq_set_enabled(uint num, bool enabled) {
+    (void)num;
+    (void)enabled;
+}
+
+#endif
@@ -0,0 +1,29 @@
+// Sustituto de hardware/pwm.h (ver simulador.c).
+#ifndef SIM_HARDWARE_PWM_H
+#define SIM_HARDWARE_PWM_H
+
+#include "pico.h"
+
+#define NUM_PWM_SLICES 8
+#define PWM_CHAN_A 0
+#define PWM_CHAN_B 1
+
+typedef struct {
+    float div;
+    uint32_t top;
+} pwm_config;
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1u) & 7u; }
+static inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1u; }
+
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_clkdiv(pwm_config *c, float div);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_clkdiv(uint slice_num, float div);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+#endif
@@ -0,0 +1,15 @@
+// Sustituto de hardware/sync.h (ver simulador.c).
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include "pico.h"
+
+// Duerme el núcleo hasta la próxima interrupción: el reloj virtual salta hasta ella.
+void __wfi(void);
+
+// Las interrupciones del simulador solo ocurren dentro de las llamadas al SDK, así que no hay nada
+// que enmascarar; el estado se devuelve para que el código quede igual que en la placa.
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t estado) { (void)estado; }
+
+#endif
@@ -0,0 +1,52 @@
+// Sustituto de hardware/timer.h y de las alarmas de pico/time.h (ver simulador.c).
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include "pico.h"
+
+typedef int32_t alarm_id_t;  // > 0 si la alarma quedó programada
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+    int64_t delay_us;
+    alarm_id_t alarm_id;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+
+// Reloj virtual
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+absolute_time_t get_absolute_time(void);
+void busy_wait_us_32(uint32_t us);
+void busy_wait_us(uint64_t us);
+void busy_wait_ms(uint32_t ms);
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline int64_t absolute_time_diff_us(absolute_time_t desde, absolute_time_t hasta) {
+    return (int64_t)(hasta - desde);
+}
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + ms * 1000ULL; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return get_absolute_time() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return get_absolute_time() + ms * 1000ULL; }
+
+// Alarmas de una vez: el callback devuelve 0 para terminar, > 0 para repetir esa cantidad de us
+// después de la vez anterior y < 0 para repetir a -valor us de ahora.
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t id);
+
+// Timers repetitivos: el callback devuelve false para detenerse. Como los callbacks no gastan
+// tiempo virtual, un retardo positivo y uno negativo dan el mismo período.
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#endif
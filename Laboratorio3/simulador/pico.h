@@ -0,0 +1,15 @@
+// Tipos básicos del SDK de la Pico para el simulador (ver simulador.c).
+#ifndef SIM_PICO_H
+#define SIM_PICO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;  // Microsegundos desde el arranque, como en el SDK sin depuración
+
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT (-1)
+
+#endif
@@ -0,0 +1,39 @@
+// Sustituto de pico/stdlib.h para compilar el firmware en Linux sobre el simulador (ver simulador.c).
+/*La entrada y la salida estándar de la Pico son las del proceso. Las funciones de stdio que usa el
+firmware pasan por el simulador para que escribir cueste tiempo virtual (como el USB de verdad) y
+para que el fin de la entrada termine la simulación en vez de dejar el firmware esperando.*/
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdio.h>  // Antes de las macros de abajo, para que no toquen las declaraciones de la libc
+#include "pico.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+
+// Arranque y conexión de la consola (la del simulador siempre está conectada)
+bool stdio_init_all(void);
+bool stdio_usb_init(void);
+bool stdio_usb_connected(void);
+
+// Un carácter de la entrada, o PICO_ERROR_TIMEOUT si no llega en 'timeout_us' de tiempo virtual.
+int getchar_timeout_us(uint32_t timeout_us);
+
+// Esperas: avanzan el reloj virtual y atienden las interrupciones que caigan en medio
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void sleep_until(absolute_time_t t);
+void tight_loop_contents(void);
+
+int sim_printf(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+int sim_putchar(int c);
+int sim_puts(const char *s);
+char *sim_fgets(char *s, int tam, FILE *f);
+
+#define printf(...) sim_printf(__VA_ARGS__)
+#define putchar(c) sim_putchar(c)
+#define puts(s) sim_puts(s)
+#define fgets(s, tam, f) sim_fgets(s, tam, f)
+
+#endif
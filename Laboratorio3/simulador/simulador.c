@@ -0,0 +1,526 @@
+// Simulador de la Raspberry Pi Pico para correr el firmware de Laboratorio3 en Linux.
+/*Compilación (desde Laboratorio3): make arma codigo*_sim para cada firmware, o a mano
+    gcc -O2 -Wall -I simulador codigo4v6.c simulador/simulador.c -o codigo4v6_sim -lm
+Compilan todos los codigo*.c salvo codigo3v1.c, que tampoco compila con el SDK de verdad: no
+incluye hardware/pwm.h y usa pwm_get_gpio_level, que el SDK no tiene.
+Uso:
+    printf '2\nPWM 60\nSTOP\n' | ./codigo4v6_sim > captura.csv
+
+Los encabezados de esta carpeta reemplazan a los del SDK (pico/stdlib.h, hardware/gpio.h,
+hardware/pwm.h, hardware/timer.h, hardware/clocks.h, hardware/irq.h, hardware/sync.h) y sus
+funciones corren sobre un reloj virtual en microsegundos. El reloj solo avanza dentro de las llamadas
+al SDK: cada lectura (time_us_32, get_absolute_time, tight_loop_contents) cuesta SIM_US_LECTURA, las
+esperas saltan directo a su final, __wfi salta hasta la próxima interrupción y escribir en la
+consola cuesta SIM_US_POR_BYTE por byte. Así un bucle de espera activa de 15 s se recorre en
+milisegundos. Las interrupciones (flancos del encoder, alarmas y timers repetitivos) se atienden en
+orden dentro de esos avances, con el reloj puesto en el instante exacto de cada una; dentro de un
+callback el reloj no avanza.
+
+Planta: motor de corriente continua de primer orden, tau * dw/dt = w_final - w, con
+w_final = SIM_RPM_MAX * (u - z) / (1 - z) si el ciclo útil u supera la zona muerta z (si no, 0).
+u es el nivel del PWM del pin SIM_PIN_PWM, o su nivel lógico si se maneja por software con
+gpio_put; si SIM_PIN_IN1 o SIM_PIN_IN2 son salidas y tienen el mismo nivel, el puente frena (u = 0).
+El sentido no importa: el encoder tiene un solo canal. Entre dos cambios de la entrada la posición
+tiene forma cerrada, así que cada flanco del encoder (SIM_RANURAS ranuras por vuelta, mitad de cada
+ranura en alto) se ubica resolviendo esa ecuación, sin integrar paso a paso.
+
+La simulación termina cuando el firmware sale de main, cuando fgets encuentra el fin de la entrada,
+SIM_FIN_S segundos virtuales después de que getchar_timeout_us lo encuentra, o al llegar a
+SIM_LIMITE_S segundos virtuales (para los firmwares que nunca terminan). Al salir se escribe en
+stderr una línea JSON con el tiempo virtual, el tiempo real, los eventos atendidos y el tiempo que el
+núcleo pasó dormido en __wfi (el resto lo pasó ocupado).
+
+Parámetros (variables de entorno, con su valor por defecto):
+    SIM_RPM_MAX 250      SIM_TAU_MS 150       SIM_ZONA_MUERTA 15 (% de ciclo útil)
+    SIM_RANURAS 20       SIM_PIN_PWM 0        SIM_PIN_IN1 1        SIM_PIN_IN2 2
+    SIM_PIN_ENCODER 10   SIM_US_LECTURA 1     SIM_US_POR_BYTE 2    SIM_LIMITE_S 600   SIM_FIN_S 1*/
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+#include "hardware/timer.h"
+
+// El simulador usa las funciones de verdad de la libc.
+#undef printf
+#undef putchar
+#undef puts
+#undef fgets
+
+#define MAX_ALARMAS 32
+
+typedef struct {
+    bool activa;
+    alarm_id_t id;
+    double cuando;  // Instante (us virtuales) en que dispara
+    alarm_callback_t callback;  // Alarma de una vez
+    void *datos;
+    repeating_timer_t *timer;  // Timer repetitivo (NULL en una alarma)
+} alarma_t;
+
+// Parámetros
+static double rpm_max, tau_us, zona_muerta, us_lectura, us_por_byte, limite_us, fin_us;
+static int ranuras, pin_pwm, pin_in1, pin_in2, pin_encoder;
+
+// Reloj y estado de los periféricos
+static double ahora = 0;  // Reloj virtual en microsegundos
+static bool en_interrupcion = false;  // Dentro de un callback el reloj no avanza
+static int funcion[NUM_BANK0_GPIOS], nivel[NUM_BANK0_GPIOS], pull[NUM_BANK0_GPIOS];  // pull: 1 arriba, -1 abajo
+static bool es_salida[NUM_BANK0_GPIOS];
+static uint32_t eventos_irq[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t callback_gpio = NULL;
+static uint16_t tope[NUM_PWM_SLICES], nivel_pwm[NUM_PWM_SLICES][2];
+static bool pwm_activo[NUM_PWM_SLICES];
+static alarma_t alarmas[MAX_ALARMAS];
+static alarm_id_t siguiente_id = 1;
+static double t_alarma = INFINITY;  // Instante de la próxima alarma activa
+static bool fin_entrada = false;
+
+// Motor: posición en medias ranuras (un flanco en cada entero) y velocidad en medias ranuras por us
+static double t_motor = 0, posicion = 1.5, velocidad = 0, velocidad_final = 0;
+static double t_flanco = INFINITY;  // Instante del próximo flanco del encoder
+
+// Contadores que se informan al salir
+static unsigned long long flancos = 0, irq_gpio = 0, disparos_alarma = 0, lecturas_reloj = 0, bytes_salida = 0;
+static unsigned long long esperas_wfi = 0;
+static double dormido_us = 0;  // Tiempo virtual pasado dentro de __wfi
+static double inicio_real;
+
+static double reloj_real_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static double parametro(const char *nombre, double por_defecto) {
+    const char *valor = getenv(nombre);
+    return valor != NULL && *valor ? atof(valor) : por_defecto;
+}
+
+static void informar(void) {
+    fflush(stdout);
+    fprintf(stderr, "{\"tipo\":\"simulador\",\"t_us\":%.0f,\"pared_us\":%.0f,\"flancos\":%llu,\"irq_gpio\":%llu,"
+            "\"alarmas\":%llu,\"lecturas_reloj\":%llu,\"bytes_salida\":%llu,\"wfi\":%llu,\"dormido_us\":%.0f,"
+            "\"rpm\":%.2f}\n",
+            ahora, reloj_real_us() - inicio_real, flancos, irq_gpio, disparos_alarma, lecturas_reloj, bytes_salida,
+            esperas_wfi, dormido_us, velocidad * 60e6 / (2.0 * ranuras));
+}
+
+__attribute__((constructor)) static void iniciar(void) {
+    rpm_max = parametro("SIM_RPM_MAX", 250);
+    tau_us = parametro("SIM_TAU_MS", 150) * 1000.0;
+    zona_muerta = parametro("SIM_ZONA_MUERTA", 15) / 100.0;
+    ranuras = (int)parametro("SIM_RANURAS", 20);
+    pin_pwm = (int)parametro("SIM_PIN_PWM", 0);
+    pin_in1 = (int)parametro("SIM_PIN_IN1", 1);
+    pin_in2 = (int)parametro("SIM_PIN_IN2", 2);
+    pin_encoder = (int)parametro("SIM_PIN_ENCODER", 10);
+    us_lectura = parametro("SIM_US_LECTURA", 1);
+    us_por_byte = parametro("SIM_US_POR_BYTE", 2);
+    limite_us = parametro("SIM_LIMITE_S", 600) * 1e6;
+    fin_us = parametro("SIM_FIN_S", 1) * 1e6;
+    if (tau_us <= 0) tau_us = 1;
+    if (ranuras < 1) ranuras = 1;
+    if (zona_muerta >= 1) zona_muerta = 0.99;
+    for (int s = 0; s < NUM_PWM_SLICES; s++) tope[s] = 0xffff;
+    for (int g = 0; g < NUM_BANK0_GPIOS; g++) funcion[g] = GPIO_FUNC_NULL;
+    inicio_real = reloj_real_us();
+    atexit(informar);
+}
+
+static bool pin_valido(uint gpio) { return gpio < NUM_BANK0_GPIOS; }
+
+// ===== Motor y encoder =====
+
+// Lleva la posición y la velocidad del motor hasta el instante t (solución exacta del primer orden).
+static void mover_motor(double t) {
+    double dt = t - t_motor;
+    if (dt <= 0) return;
+    double caida = exp(-dt / tau_us);
+    posicion += velocidad_final * dt + (velocidad - velocidad_final) * tau_us * (1.0 - caida);
+    velocidad = velocidad_final + (velocidad - velocidad_final) * caida;
+    t_motor = t;
+}
+
+// Tiempo que tarda el motor, desde su estado actual, en recorrer d medias ranuras (INFINITY si no llega).
+static double tiempo_para(double d) {
+    double v0 = velocidad, vf = velocidad_final;
+    if (vf <= 0) {
+        // Se va frenando: recorre como máximo v0 * tau, y la ecuación se despeja directo.
+        if (v0 * tau_us <= d) return INFINITY;
+        return -tau_us * log(1.0 - d / (v0 * tau_us));
+    }
+    // La distancia recorrida crece con el tiempo y en d / vf + tau ya pasó de d: bisección con Newton.
+    double bajo = 0, alto = d / vf + tau_us, t = d / (v0 > vf ? v0 : vf);
+    for (int k = 0; k < 100 && alto - bajo > 1e-4; k++) {
+        double caida = exp(-t / tau_us);
+        double f = vf * t + (v0 - vf) * tau_us * (1.0 - caida) - d;
+        double v = vf + (v0 - vf) * caida;
+        if (f < 0) bajo = t;
+        else alto = t;
+        t = t - f / v;
+        if (!(t > bajo && t < alto)) t = (bajo + alto) / 2;
+    }
+    return alto;
+}
+
+static void programar_flanco(void) {
+    t_flanco = t_motor + tiempo_para(floor(posicion) + 1.0 - posicion);
+}
+
+// Ciclo útil que recibe el motor, entre 0 y 1.
+static double entrada_motor(void) {
+    bool puente = (pin_valido(pin_in1) && es_salida[pin_in1]) || (pin_valido(pin_in2) && es_salida[pin_in2]);
+    if (puente) {
+        int a = pin_valido(pin_in1) && es_salida[pin_in1] ? nivel[pin_in1] : 0;
+        int b = pin_valido(pin_in2) && es_salida[pin_in2] ? nivel[pin_in2] : 0;
+        if (a == b) return 0.0;  // Freno
+    }
+    if (!pin_valido(pin_pwm)) return 0.0;
+    if (funcion[pin_pwm] == GPIO_FUNC_PWM) {
+        uint s = pwm_gpio_to_slice_num(pin_pwm);
+        if (!pwm_activo[s]) return 0.0;
+        double u = (double)nivel_pwm[s][pwm_gpio_to_channel(pin_pwm)] / ((double)tope[s] + 1.0);
+        return u > 1.0 ? 1.0 : u;
+    }
+    return funcion[pin_pwm] == GPIO_FUNC_SIO && es_salida[pin_pwm] ? nivel[pin_pwm] : 0.0;
+}
+
+// Se llama después de tocar cualquier cosa que pueda cambiar la entrada del motor.
+static void entrada_cambiada(void) {
+    mover_motor(ahora);
+    double u = entrada_motor();
+    double util = u > zona_muerta ? (u - zona_muerta) / (1.0 - zona_muerta) : 0.0;
+    double final = util * rpm_max / 60.0 * 2.0 * ranuras / 1e6;
+    if (final == velocidad_final) return;
+    velocidad_final = final;
+    programar_flanco();
+}
+
+static bool nivel_encoder(void) { return ((long long)floor(posicion) & 1) == 0; }
+
+// El motor llegó a un flanco: se fija la posición en el entero para no acumular redondeo.
+static void atender_flanco(void) {
+    mover_motor(t_flanco);
+    posicion = floor(posicion + 0.5);
+    flancos++;
+    uint32_t evento = nivel_encoder() ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if (pin_valido(pin_encoder) && callback_gpio != NULL && (eventos_irq[pin_encoder] & evento)) {
+        irq_gpio++;
+        callback_gpio(pin_encoder, evento);
+    }
+    programar_flanco();
+}
+
+// ===== Reloj virtual =====
+
+static int proxima_alarma(void) {
+    int mejor = -1;
+    for (int a = 0; a < MAX_ALARMAS; a++)
+        if (alarmas[a].activa && (mejor < 0 || alarmas[a].cuando < alarmas[mejor].cuando)) mejor = a;
+    return mejor;
+}
+
+// Se llama cada vez que se programa, dispara o cancela una alarma.
+static void actualizar_alarmas(void) {
+    int a = proxima_alarma();
+    t_alarma = a >= 0 ? alarmas[a].cuando : INFINITY;
+}
+
+static void atender_alarma(alarma_t *a) {
+    disparos_alarma++;
+    alarm_id_t id = a->id;
+    if (a->timer != NULL) {
+        repeating_timer_t *rt = a->timer;
+        bool seguir = rt->callback(rt);
+        if (a->activa && a->id == id) {  // El callback pudo cancelarlo
+            if (seguir) a->cuando += (double)llabs(rt->delay_us);
+            else a->activa = false;
+        }
+    } else {
+        int64_t repetir = a->callback(id, a->datos);
+        if (a->activa && a->id == id) {
+            if (repetir > 0) a->cuando += (double)repetir;
+            else if (repetir < 0) a->cuando = ahora - (double)repetir;
+            else a->activa = false;
+        }
+    }
+}
+
+static void terminar(void) {
+    exit(0);  // informar() corre desde atexit
+}
+
+// Avanza el reloj hasta 'hasta' atendiendo en orden los flancos y las alarmas que caen antes.
+/*Es lo que más se llama (una vez por lectura del reloj), por eso el caso sin eventos en medio
+solo compara con los dos próximos instantes ya calculados.*/
+static void avanzar(double hasta) {
+    if (en_interrupcion) return;
+    while (t_flanco <= hasta || t_alarma <= hasta) {
+        double t = t_flanco < t_alarma ? t_flanco : t_alarma;
+        if (t < ahora) t = ahora;  // Alarma programada en el pasado
+        if (t > limite_us) terminar();
+        ahora = t;
+        en_interrupcion = true;
+        if (t_flanco < t_alarma) atender_flanco();
+        else atender_alarma(&alarmas[proxima_alarma()]);
+        en_interrupcion = false;
+        actualizar_alarmas();
+    }
+    if (hasta > limite_us) {
+        ahora = limite_us;
+        terminar();
+    }
+    if (hasta > ahora) ahora = hasta;
+}
+
+uint64_t time_us_64(void) {
+    lecturas_reloj++;
+    avanzar(ahora + us_lectura);
+    return (uint64_t)ahora;
+}
+
+uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+absolute_time_t get_absolute_time(void) { return time_us_64(); }
+void tight_loop_contents(void) { avanzar(ahora + us_lectura); }
+void busy_wait_us(uint64_t us) { avanzar(ahora + (double)us); }
+void busy_wait_us_32(uint32_t us) { avanzar(ahora + us); }
+void busy_wait_ms(uint32_t ms) { avanzar(ahora + ms * 1000.0); }
+void sleep_us(uint64_t us) { avanzar(ahora + (double)us); }
+void sleep_ms(uint32_t ms) { avanzar(ahora + ms * 1000.0); }
+void sleep_until(absolute_time_t t) { avanzar((double)t); }
+
+// Duerme hasta que corra un callback (los flancos sin interrupción habilitada no despiertan).
+/*En la placa, con las interrupciones enmascaradas (save_and_disable_interrupts) __wfi despierta pero
+el callback corre al rehabilitarlas; aquí corre adentro de __wfi. Para el patrón habitual (revisar
+una bandera con las interrupciones enmascaradas y dormir si no cambió) es lo mismo.*/
+void __wfi(void) {
+    if (en_interrupcion) return;
+    unsigned long long atendidas = irq_gpio + disparos_alarma;
+    double desde = ahora;
+    esperas_wfi++;
+    while (irq_gpio + disparos_alarma == atendidas) {
+        double t = t_flanco < t_alarma ? t_flanco : t_alarma;
+        if (t == INFINITY) {
+            fprintf(stderr, "simulador: __wfi sin ninguna interrupcion por venir\n");
+            terminar();
+        }
+        avanzar(t);
+    }
+    dormido_us += ahora - desde;
+}
+
+// ===== Alarmas y timers =====
+
+static alarma_t *nueva_alarma(double cuando) {
+    for (int a = 0; a < MAX_ALARMAS; a++) {
+        if (!alarmas[a].activa) {
+            memset(&alarmas[a], 0, sizeof(alarma_t));
+            alarmas[a].activa = true;
+            alarmas[a].id = siguiente_id++;
+            alarmas[a].cuando = cuando;
+            if (cuando < t_alarma) t_alarma = cuando;
+            return &alarmas[a];
+        }
+    }
+    return NULL;  // Como el SDK cuando se acaban las alarmas del pool
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    (void)fire_if_past;  // En el simulador una alarma nunca queda en el pasado al programarla
+    alarma_t *a = nueva_alarma(ahora + (double)us);
+    if (a == NULL) return -1;
+    a->callback = callback;
+    a->datos = user_data;
+    return a->id;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_in_us(ms * 1000ULL, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t id) {
+    for (int a = 0; a < MAX_ALARMAS; a++) {
+        if (alarmas[a].activa && alarmas[a].id == id) {
+            alarmas[a].activa = false;
+            actualizar_alarmas();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    if (delay_us == 0) delay_us = 1;
+    alarma_t *a = nueva_alarma(ahora + (double)llabs(delay_us));
+    if (a == NULL) return false;
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = a->id;
+    a->timer = out;
+    return true;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    return add_repeating_timer_us(delay_ms * 1000LL, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    bool cancelado = cancel_alarm(timer->alarm_id);
+    timer->alarm_id = 0;
+    return cancelado;
+}
+
+// ===== GPIO =====
+
+void gpio_init(uint gpio) {
+    if (!pin_valido(gpio)) return;
+    funcion[gpio] = GPIO_FUNC_SIO;
+    es_salida[gpio] = false;
+    nivel[gpio] = 0;
+    entrada_cambiada();
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    if (!pin_valido(gpio)) return;
+    funcion[gpio] = fn;
+    entrada_cambiada();
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (!pin_valido(gpio)) return;
+    es_salida[gpio] = out;
+    entrada_cambiada();
+}
+
+void gpio_put(uint gpio, bool valor) {
+    if (!pin_valido(gpio)) return;
+    nivel[gpio] = valor;
+    entrada_cambiada();
+}
+
+bool gpio_get(uint gpio) {
+    if (!pin_valido(gpio)) return false;
+    if ((int)gpio == pin_encoder) {
+        mover_motor(ahora);
+        return nivel_encoder();
+    }
+    if (es_salida[gpio]) return nivel[gpio];
+    return pull[gpio] > 0;
+}
+
+void gpio_pull_up(uint gpio) { if (pin_valido(gpio)) pull[gpio] = 1; }
+void gpio_pull_down(uint gpio) { if (pin_valido(gpio)) pull[gpio] = -1; }
+void gpio_disable_pulls(uint gpio) { if (pin_valido(gpio)) pull[gpio] = 0; }
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if (!pin_valido(gpio)) return;
+    if (enabled) eventos_irq[gpio] |= events;
+    else eventos_irq[gpio] &= ~events;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, events, enabled);
+    if (enabled) callback_gpio = callback;
+}
+
+// ===== PWM =====
+
+pwm_config pwm_get_default_config(void) {
+    pwm_config c = {1.0f, 0xffff};
+    return c;
+}
+
+void pwm_config_set_clkdiv(pwm_config *c, float div) { c->div = div; }
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) { c->top = wrap; }
+
+// El divisor no cambia el ciclo útil, y la frecuencia del PWM es mucho mayor que 1/tau.
+void pwm_set_clkdiv(uint slice_num, float div) {
+    (void)slice_num;
+    (void)div;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+    slice_num &= NUM_PWM_SLICES - 1;
+    tope[slice_num] = (uint16_t)c->top;
+    nivel_pwm[slice_num][0] = nivel_pwm[slice_num][1] = 0;
+    pwm_activo[slice_num] = start;
+    entrada_cambiada();
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+    tope[slice_num & (NUM_PWM_SLICES - 1)] = wrap;
+    entrada_cambiada();
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    nivel_pwm[slice_num & (NUM_PWM_SLICES - 1)][chan & 1] = level;
+    entrada_cambiada();
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+    pwm_activo[slice_num & (NUM_PWM_SLICES - 1)] = enabled;
+    entrada_cambiada();
+}
+
+// ===== Consola =====
+
+bool stdio_init_all(void) { return true; }
+bool stdio_usb_init(void) { return true; }
+bool stdio_usb_connected(void) { return true; }
+
+// Lo escrito ocupa el USB: el reloj avanza lo que tarda en salir.
+static void cobrar_salida(int bytes) {
+    if (bytes <= 0) return;
+    bytes_salida += bytes;
+    avanzar(ahora + bytes * us_por_byte);
+}
+
+int sim_printf(const char *formato, ...) {
+    va_list args;
+    va_start(args, formato);
+    int escritos = vprintf(formato, args);
+    va_end(args);
+    cobrar_salida(escritos);
+    return escritos;
+}
+
+int sim_putchar(int c) {
+    int r = putchar(c);
+    cobrar_salida(1);
+    return r;
+}
+
+int sim_puts(const char *s) {
+    int r = puts(s);
+    cobrar_salida((int)strlen(s) + 1);
+    return r;
+}
+
+// Un fgets de la consola que llega al final no va a volver nunca: la simulación termina ahí.
+char *sim_fgets(char *s, int tam, FILE *f) {
+    char *r = fgets(s, tam, f);
+    if (r == NULL && f == stdin) terminar();
+    return r;
+}
+
+// La entrada está disponible en cuanto se pide; al terminarse se deja correr SIM_FIN_S más.
+int getchar_timeout_us(uint32_t timeout_us) {
+    if (!fin_entrada) {
+        int c = getchar();
+        if (c != EOF) return c;
+        fin_entrada = true;
+        if (ahora + fin_us < limite_us) limite_us = ahora + fin_us;
+    }
+    avanzar(ahora + timeout_us);
+    return PICO_ERROR_TIMEOUT;
+}